@@ -16,6 +16,7 @@ otherwise accompanies this software in either electronic or hard copy form.
 ************************************************************************************/
 
 #include "OVR_Atomic.h"
+#include "OVR_Timer.h"
 
 #ifdef OVR_ENABLE_THREADS
 
@@ -35,6 +36,7 @@ namespace OVR {
 
 // Constructors
 Lock::Lock(unsigned spinCount)
+    : StatsEnabled(false)
 {
 #if defined(NTDDI_WIN8) && (NTDDI_VERSION >= NTDDI_WIN8)
    // On Windows 8 we use InitializeCriticalSectionEx due to Metro-Compatibility
@@ -74,9 +76,59 @@ Lock::~Lock()
     DeleteCriticalSection(&cs);
 }
 
+void Lock::lockContended()
+{
+    // Spinning is done by the critical section itself.
+    UInt64 start = Timer::GetProfileTicks();
+    ::EnterCriticalSection(&cs);
+    if (StatsEnabled)
+    {
+        Stats.Acquisitions++;
+        Stats.ContendedAcquisitions++;
+        Stats.WaitTicks += Timer::GetProfileTicks() - start;
+    }
+}
+
+
+#endif
 
+
+// ***** Lock statistics
+
+// These take the lock without DoLock, so that they aren't counted.
+
+void Lock::EnableStats(bool enable)
+{
+#if defined(OVR_OS_WIN32)
+    ::EnterCriticalSection(&cs);
+#else
+    pthread_mutex_lock(&mutex);
 #endif
 
+    StatsEnabled = enable;
+    if (enable)
+        Stats = LockStats();
+
+#if defined(OVR_OS_WIN32)
+    ::LeaveCriticalSection(&cs);
+#else
+    pthread_mutex_unlock(&mutex);
+#endif
+}
+
+void Lock::GetStats(LockStats* stats)
+{
+#if defined(OVR_OS_WIN32)
+    ::EnterCriticalSection(&cs);
+    *stats = Stats;
+    ::LeaveCriticalSection(&cs);
+#else
+    pthread_mutex_lock(&mutex);
+    *stats = Stats;
+    pthread_mutex_unlock(&mutex);
+#endif
+}
+
 } // OVR
 
 #endif // OVR_ENABLE_THREADS
@@ -40,6 +40,7 @@ template<class T> class AtomicInt;
 template<class T> class AtomicPtr;
 
 class   Lock;
+struct  LockStats;
 
 
 //-----------------------------------------------------------------------------------
@@ -60,6 +61,17 @@ class   Lock;
 //  - Sync.    A combination of Release and Acquire.
 
 
+// GCC 4.7+ and Clang provide __atomic builtins that take an explicit memory order.
+// With them NoSync, Acquire and Release operations become relaxed, acquire and
+// release ones rather than full barriers, and Load_Acquire/Store_Release become
+// plain loads and stores where the CPU allows. Sync operations are sequentially
+// consistent. Define OVR_ATOMIC_NO_BUILTINS to use the per-CPU versions instead.
+#if defined(OVR_ENABLE_THREADS) && defined(OVR_CC_GNU) && defined(__ATOMIC_ACQ_REL) && \
+    !defined(OVR_ATOMIC_NO_BUILTINS)
+#define OVR_ATOMIC_BUILTINS
+#endif
+
+
 // *** AtomicOpsRaw
 
 // AtomicOpsRaw is a specialized template that provides atomic operations 
@@ -523,12 +535,50 @@ struct AtomicOpsRaw_DefImpl : public O
     inline static void  Store_Release(volatile O_T* p, O_T val)  { O_ReleaseSync sync; OVR_UNUSED(sync); *p = val; }
 #endif
     inline static O_T   Load_Acquire(const volatile O_T* p)      { O_AcquireSync sync; OVR_UNUSED(sync); return *p; }
+    inline static O_T   Load_NoSync(const volatile O_T* p)       { return *p; }
+};
+
+
+#if defined(OVR_ATOMIC_BUILTINS)
+
+// AtomicOpsRaw implementation on the __atomic builtins; each sync type maps to a
+// memory order, so no sync objects are needed.
+template<class T_>
+struct AtomicOpsRaw_BuiltinImpl : public AtomicOpsRawBase
+{
+    typedef T_ T;
+
+    inline static T     Exchange_Sync(volatile T* p, T val)                 { return __atomic_exchange_n(p, val, __ATOMIC_SEQ_CST); }
+    inline static T     Exchange_Release(volatile T* p, T val)              { return __atomic_exchange_n(p, val, __ATOMIC_RELEASE); }
+    inline static T     Exchange_Acquire(volatile T* p, T val)              { return __atomic_exchange_n(p, val, __ATOMIC_ACQUIRE); }
+    inline static T     Exchange_NoSync(volatile T* p, T val)               { return __atomic_exchange_n(p, val, __ATOMIC_RELAXED); }
+    inline static T     ExchangeAdd_Sync(volatile T* p, T val)              { return __atomic_fetch_add(p, val, __ATOMIC_SEQ_CST); }
+    inline static T     ExchangeAdd_Release(volatile T* p, T val)           { return __atomic_fetch_add(p, val, __ATOMIC_RELEASE); }
+    inline static T     ExchangeAdd_Acquire(volatile T* p, T val)           { return __atomic_fetch_add(p, val, __ATOMIC_ACQUIRE); }
+    inline static T     ExchangeAdd_NoSync(volatile T* p, T val)            { return __atomic_fetch_add(p, val, __ATOMIC_RELAXED); }
+    inline static bool  CompareAndSet_Sync(volatile T* p, T c, T val)       { return __atomic_compare_exchange_n(p, &c, val, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+    inline static bool  CompareAndSet_Release(volatile T* p, T c, T val)    { return __atomic_compare_exchange_n(p, &c, val, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED); }
+    inline static bool  CompareAndSet_Acquire(volatile T* p, T c, T val)    { return __atomic_compare_exchange_n(p, &c, val, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE); }
+    inline static bool  CompareAndSet_NoSync(volatile T* p, T c, T val)     { return __atomic_compare_exchange_n(p, &c, val, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED); }
+
+    inline static void  Store_Release(volatile T* p, T val)                 { __atomic_store_n(p, val, __ATOMIC_RELEASE); }
+    inline static T     Load_Acquire(const volatile T* p)                   { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+    inline static T     Load_NoSync(const volatile T* p)                    { return __atomic_load_n(p, __ATOMIC_RELAXED); }
 };
 
+#endif
+
 
 template<int size>
 struct AtomicOpsRaw : public AtomicOpsRawBase { };
 
+#if defined(OVR_ATOMIC_BUILTINS)
+
+template<>
+struct AtomicOpsRaw<4> : public AtomicOpsRaw_BuiltinImpl<UInt32> { };
+
+#else
+
 template<>
 struct AtomicOpsRaw<4> : public AtomicOpsRaw_DefImpl<AtomicOpsRaw_4ByteImpl>
 {   
@@ -536,6 +586,18 @@ struct AtomicOpsRaw<4> : public AtomicOpsRaw_DefImpl<AtomicOpsRaw_4ByteImpl>
     AtomicOpsRaw()
     { OVR_COMPILER_ASSERT(sizeof(AtomicOpsRaw_DefImpl<AtomicOpsRaw_4ByteImpl>::T) == 4); }
 };
+
+#endif
+
+// 8-byte builtins may need libatomic on 32-bit CPUs, so they are only used with
+// 64-bit pointers, like the per-CPU versions.
+#if defined(OVR_ATOMIC_BUILTINS) && defined(OVR_64BIT_POINTERS)
+
+template<>
+struct AtomicOpsRaw<8> : public AtomicOpsRaw_BuiltinImpl<UInt64> { };
+
+#else
+
 template<>
 struct AtomicOpsRaw<8> : public AtomicOpsRaw_DefImpl<AtomicOpsRaw_8ByteImpl>
 {
@@ -543,6 +605,8 @@ struct AtomicOpsRaw<8> : public AtomicOpsRaw_DefImpl<AtomicOpsRaw_8ByteImpl>
     { OVR_COMPILER_ASSERT(sizeof(AtomicOpsRaw_DefImpl<AtomicOpsRaw_8ByteImpl>::T) == 8); }
 };
 
+#endif
+
 
 // *** AtomicOps - implementation of atomic Ops for specified class
 
@@ -572,11 +636,12 @@ public:
     inline static C     ExchangeAdd_NoSync(volatile C* p, C val)        { C2T_union u; u.c = val; u.t = Ops::ExchangeAdd_NoSync((PT)p, u.t); return u.c; }
     inline static bool  CompareAndSet_Sync(volatile C* p, C c, C val)   { C2T_union u,cu; u.c = val; cu.c = c; return Ops::CompareAndSet_Sync((PT)p, cu.t, u.t); }
     inline static bool  CompareAndSet_Release(volatile C* p, C c, C val){ C2T_union u,cu; u.c = val; cu.c = c; return Ops::CompareAndSet_Release((PT)p, cu.t, u.t); }
-    inline static bool  CompareAndSet_Relse(volatile C* p, C c, C val){ C2T_union u,cu; u.c = val; cu.c = c; return Ops::CompareAndSet_Acquire((PT)p, cu.t, u.t); }
+    inline static bool  CompareAndSet_Acquire(volatile C* p, C c, C val){ C2T_union u,cu; u.c = val; cu.c = c; return Ops::CompareAndSet_Acquire((PT)p, cu.t, u.t); }
     inline static bool  CompareAndSet_NoSync(volatile C* p, C c, C val) { C2T_union u,cu; u.c = val; cu.c = c; return Ops::CompareAndSet_NoSync((PT)p, cu.t, u.t); }
     // Loads and stores with memory fence. These have only the relevant versions.    
     inline static void  Store_Release(volatile C* p, C val)             { C2T_union u; u.c = val; Ops::Store_Release((PT)p, u.t); }    
     inline static C     Load_Acquire(const volatile C* p)               { C2T_union u; u.t = Ops::Load_Acquire((PT)p); return u.c; }
+    inline static C     Load_NoSync(const volatile C* p)                { C2T_union u; u.t = Ops::Load_NoSync((PT)p); return u.c; }
 };
 
 
@@ -596,7 +661,7 @@ public:
 
     // Most libraries (TBB and Joshua Scholar's) library do not do Load_Acquire
     // here, since most algorithms do not require atomic loads. Needs some research.    
-    inline operator T() const { return Value; }
+    inline operator T() const { return Ops::Load_NoSync(&Value); }
 
     // *** Standard Atomic inlines
     inline T     Exchange_Sync(T val)               { return Ops::Exchange_Sync(&Value,  val); }
@@ -605,7 +670,7 @@ public:
     inline T     Exchange_NoSync(T val)             { return Ops::Exchange_NoSync(&Value, val); }
     inline bool  CompareAndSet_Sync(T c, T val)     { return Ops::CompareAndSet_Sync(&Value, c, val); }
     inline bool  CompareAndSet_Release(T c, T val)  { return Ops::CompareAndSet_Release(&Value, c, val); }
-    inline bool  CompareAndSet_Acquire(T c, T val)  { return Ops::CompareAndSet_Relse(&Value, c, val); }
+    inline bool  CompareAndSet_Acquire(T c, T val)  { return Ops::CompareAndSet_Acquire(&Value, c, val); }
     inline bool  CompareAndSet_NoSync(T c, T val)   { return Ops::CompareAndSet_NoSync(&Value, c, val); }
     // Load & Store.
     inline void  Store_Release(T val)               { Ops::Store_Release(&Value, val); }
@@ -780,6 +845,17 @@ public:
 //-----------------------------------------------------------------------------------
 // ***** Lock
 
+// Contention statistics kept by a Lock after EnableStats(true).
+struct LockStats
+{
+    UInt64  Acquisitions;           // DoLock calls, including recursive ones.
+    UInt64  ContendedAcquisitions;  // DoLock calls that found the lock held.
+    UInt64  WaitTicks;              // Time spent in contended DoLock calls, in mks.
+
+    LockStats() : Acquisitions(0), ContendedAcquisitions(0), WaitTicks(0) { }
+};
+
+
 // Lock is a simplest and most efficient mutual-exclusion lock class.
 // Unlike Mutex, it cannot be waited on.
 
@@ -804,25 +880,52 @@ public:
     inline void DoLock() { }
     inline void Unlock() { }
 
+    inline void EnableStats(bool) { }
+    inline void GetStats(LockStats* stats) { *stats = LockStats(); }
+
    // Windows.   
 #elif defined(OVR_OS_WIN32)
 
     CRITICAL_SECTION cs;
+    bool             StatsEnabled;
+    LockStats        Stats;
+
+    void    lockContended();
 public:   
+    // Critical sections spin up to spinCount times before blocking.
     Lock(unsigned spinCount = 0);      
     ~Lock();
     // Locking functions.
-    inline void DoLock()    { ::EnterCriticalSection(&cs); }
+    inline void DoLock()
+    {
+        if (!StatsEnabled)
+            ::EnterCriticalSection(&cs);
+        else if (::TryEnterCriticalSection(&cs))
+            Stats.Acquisitions++;
+        else
+            lockContended();
+    }
     inline void Unlock()    { ::LeaveCriticalSection(&cs); }
 
 #else
     pthread_mutex_t mutex;
-
+    unsigned        SpinCount;
+    // Running average of the spins that contended acquisitions needed, where
+    // those that ended up blocking count as zero.
+    unsigned        SpinEstimate;
+    bool            StatsEnabled;
+    LockStats       Stats;
+
+    void    lockContended();
 public:
     static pthread_mutexattr_t RecursiveAttr;
     static bool                RecursiveAttrInit;
 
-    Lock (unsigned dummy = 0)
+    // If the lock is held, DoLock spins for up to about spinCount pauses, retrying
+    // with exponential backoff, before blocking. Spinning adapts to how long recent
+    // acquisitions had to wait, and is skipped on single-CPU systems.
+    Lock (unsigned spinCount = 0)
+        : SpinCount(spinCount), SpinEstimate(0), StatsEnabled(false)
     {
         if (!RecursiveAttrInit)
         {
@@ -833,13 +936,31 @@ public:
         pthread_mutex_init(&mutex,&RecursiveAttr);
     }
     ~Lock ()                { pthread_mutex_destroy(&mutex); }
-    inline void DoLock()    { pthread_mutex_lock(&mutex); }
+    inline void DoLock()
+    {
+        if (pthread_mutex_trylock(&mutex) != 0)
+            lockContended();
+        else if (StatsEnabled)
+            Stats.Acquisitions++;
+    }
     inline void Unlock()    { pthread_mutex_unlock(&mutex); }
 
 #endif // OVR_ENABLE_THREDS
 
+#if defined(OVR_ENABLE_THREADS)
+    // Starts gathering statistics from zero, or stops. Counters are updated while
+    // the lock is held, so they need no atomic operations.
+    void    EnableStats(bool enable);
+    // Copies the statistics gathered since the last EnableStats(true).
+    void    GetStats(LockStats* stats);
+#endif
+
 
 public:
+    // Spin count suggested for locks held over a few instructions on hot paths, where
+    // spinning briefly is cheaper than a sleep/wake cycle.
+    enum { ShortSectionSpinCount = 1000 };
+
     // Locker class, used for automatic locking
     class Locker
     {
@@ -60,47 +60,50 @@ const double Math<double>::SingularityRadius = 0.000000000001; // Use for Gimbal
 
 
 //-------------------------------------------------------------------------------------
-// ***** Matrix4f
+// ***** Matrix4
 
 
-Matrix4f Matrix4f::LookAtRH(const Vector3f& eye, const Vector3f& at, const Vector3f& up)
+template<class T>
+Matrix4<T> Matrix4<T>::LookAtRH(const Vector3<T>& eye, const Vector3<T>& at, const Vector3<T>& up)
 {
-    Vector3f z = (eye - at).Normalized();  // Forward
-    Vector3f x = up.Cross(z).Normalized(); // Right
-    Vector3f y = z.Cross(x);
-
-    Matrix4f m(x.x,  x.y,  x.z,  -(x * eye),
-               y.x,  y.y,  y.z,  -(y * eye),
-               z.x,  z.y,  z.z,  -(z * eye),
-               0,    0,    0,    1 );
+    Vector3<T> z = (eye - at).Normalized();  // Forward
+    Vector3<T> x = up.Cross(z).Normalized(); // Right
+    Vector3<T> y = z.Cross(x);
+
+    Matrix4<T> m(x.x,  x.y,  x.z,  -(x * eye),
+                 y.x,  y.y,  y.z,  -(y * eye),
+                 z.x,  z.y,  z.z,  -(z * eye),
+                 0,    0,    0,    1 );
     return m;
 }
 
-Matrix4f Matrix4f::LookAtLH(const Vector3f& eye, const Vector3f& at, const Vector3f& up)
+template<class T>
+Matrix4<T> Matrix4<T>::LookAtLH(const Vector3<T>& eye, const Vector3<T>& at, const Vector3<T>& up)
 {
-    Vector3f z = (at - eye).Normalized();  // Forward
-    Vector3f x = up.Cross(z).Normalized(); // Right
-    Vector3f y = z.Cross(x);
-
-    Matrix4f m(x.x,  x.y,  x.z,  -(x * eye),
-               y.x,  y.y,  y.z,  -(y * eye),
-               z.x,  z.y,  z.z,  -(z * eye),
-               0,    0,    0,    1 ); 
+    Vector3<T> z = (at - eye).Normalized();  // Forward
+    Vector3<T> x = up.Cross(z).Normalized(); // Right
+    Vector3<T> y = z.Cross(x);
+
+    Matrix4<T> m(x.x,  x.y,  x.z,  -(x * eye),
+                 y.x,  y.y,  y.z,  -(y * eye),
+                 z.x,  z.y,  z.z,  -(z * eye),
+                 0,    0,    0,    1 ); 
     return m;
 }
 
 
-Matrix4f Matrix4f::PerspectiveLH(float yfov, float aspect, float znear, float zfar)
+template<class T>
+Matrix4<T> Matrix4<T>::PerspectiveLH(T yfov, T aspect, T znear, T zfar)
 {
-    Matrix4f m;
-    float    tanHalfFov = tan(yfov * 0.5f);
+    Matrix4<T> m;
+    T    tanHalfFov = tan(yfov * T(0.5));
 
-    m.M[0][0] = 1.0f / (aspect * tanHalfFov);
-    m.M[1][1] = 1.0f / tanHalfFov;
+    m.M[0][0] = T(1.0) / (aspect * tanHalfFov);
+    m.M[1][1] = T(1.0) / tanHalfFov;
     m.M[2][2] = zfar / (zfar - znear);
-    m.M[3][2] = 1.0f;
+    m.M[3][2] = T(1.0);
     m.M[2][3] = (zfar * znear) / (znear - zfar);
-    m.M[3][3] = 0.0f;
+    m.M[3][3] = T(0.0);
 
     // Note: Post-projection matrix result assumes Left-Handed coordinate system,
     //       with Y up, X right and Z forward. This supports positive z-buffer values.
@@ -108,18 +111,19 @@ Matrix4f Matrix4f::PerspectiveLH(float yfov, float aspect, float znear, float zf
 }
 
 
-Matrix4f Matrix4f::PerspectiveRH(float yfov, float aspect, float znear, float zfar)
+template<class T>
+Matrix4<T> Matrix4<T>::PerspectiveRH(T yfov, T aspect, T znear, T zfar)
 {
-    Matrix4f m;
-    float    tanHalfFov = tan(yfov * 0.5f);
+    Matrix4<T> m;
+    T    tanHalfFov = tan(yfov * T(0.5));
   
-    m.M[0][0] = 1.0f / (aspect * tanHalfFov);
-    m.M[1][1] = 1.0f / tanHalfFov;
+    m.M[0][0] = T(1.0) / (aspect * tanHalfFov);
+    m.M[1][1] = T(1.0) / tanHalfFov;
     m.M[2][2] = zfar / (znear - zfar);
    // m.M[2][2] = zfar / (zfar - znear);
-    m.M[3][2] = -1.0f;
+    m.M[3][2] = -T(1.0);
     m.M[2][3] = (zfar * znear) / (znear - zfar);
-    m.M[3][3] = 0.0f;
+    m.M[3][3] = T(0.0);
 
     // Note: Post-projection matrix result assumes Left-Handed coordinate system,    
     //       with Y up, X right and Z forward. This supports positive z-buffer values.
@@ -139,15 +143,21 @@ OffCenterLH
 */
 
 
-Matrix4f Matrix4f::Ortho2D(float w, float h)
+template<class T>
+Matrix4<T> Matrix4<T>::Ortho2D(T w, T h)
 {
-    Matrix4f m;
-    m.M[0][0] = 2.0f/w;
-    m.M[1][1] = -2.0f/h;
+    Matrix4<T> m;
+    m.M[0][0] = T(2.0)/w;
+    m.M[1][1] = -T(2.0)/h;
     m.M[0][3] = -1.0;
     m.M[1][3] = 1.0;
     m.M[2][2] = 0;
     return m;
 }
 
+
+// Both precisions are built into the library so the out-of-line members above link.
+template class Matrix4<float>;
+template class Matrix4<double>;
+
 }
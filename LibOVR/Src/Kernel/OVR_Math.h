@@ -23,6 +23,7 @@ otherwise accompanies this software in either electronic or hard copy form.
 
 #include "OVR_Types.h"
 #include "OVR_RefCount.h"
+#include "OVR_MathSIMD.h"
 
 namespace OVR {
 
@@ -231,6 +232,10 @@ public:
     Vector3(T x_, T y_, T z_ = 0) : x(x_), y(y_), z(z_) { }
     explicit Vector3(T s) : x(s), y(s), z(s) { }
 
+    // Converts from a vector of different precision.
+    template<class U>
+    explicit Vector3(const Vector3<U>& src) : x(T(src.x)), y(T(src.y)), z(T(src.z)) { }
+
     bool     operator== (const Vector3& b) const  { return x == b.x && y == b.y && z == b.z; }
     bool     operator!= (const Vector3& b) const  { return x != b.x || y != b.y || z != b.z; }
              
@@ -301,9 +306,9 @@ typedef Vector3<double> Vector3d;
 
 
 //-------------------------------------------------------------------------------------
-// ***** Matrix4f 
+// ***** Matrix4
 
-// Matrix4f is a 4x4 matrix used for 3d transformations and projections.
+// Matrix4 is a 4x4 matrix used for 3d transformations and projections.
 // Translation stored in the last column.
 // The matrix is stored in row-major order in memory, meaning that values
 // of the first row are stored before the next one.
@@ -327,29 +332,42 @@ typedef Vector3<double> Vector3d;
 //  | 30   31   32   33 |
 //
 //  The basis vectors are first three columns.
+//
+// Matrix4f is used for rendering; Matrix4d is available where float precision is not
+// enough, such as large world coordinates or long accumulated transform chains.
 
-class Matrix4f
+template<class T>
+class Matrix4
 {
-    static Matrix4f IdentityValue;
+    static Matrix4 IdentityValue;
 
 public:
-    float M[4][4];    
+    T M[4][4];    
 
     enum NoInitType { NoInit };
 
     // Construct with no memory initialization.
-    Matrix4f(NoInitType) { }
+    Matrix4(NoInitType) { }
+
+    // Converts from a matrix of different precision.
+    template<class U>
+    explicit Matrix4(const Matrix4<U>& src)
+    {
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                M[i][j] = T(src.M[i][j]);
+    }
 
     // By default, we construct identity matrix.
-    Matrix4f()
+    Matrix4()
     {
         SetIdentity();        
     }
 
-    Matrix4f(float m11, float m12, float m13, float m14,
-             float m21, float m22, float m23, float m24,
-             float m31, float m32, float m33, float m34,
-             float m41, float m42, float m43, float m44)
+    Matrix4(T m11, T m12, T m13, T m14,
+             T m21, T m22, T m23, T m24,
+             T m31, T m32, T m33, T m34,
+             T m41, T m42, T m43, T m44)
     {
         M[0][0] = m11; M[0][1] = m12; M[0][2] = m13; M[0][3] = m14;
         M[1][0] = m21; M[1][1] = m22; M[1][2] = m23; M[1][3] = m24;
@@ -357,9 +375,9 @@ public:
         M[3][0] = m41; M[3][1] = m42; M[3][2] = m43; M[3][3] = m44;
     }
 
-    Matrix4f(float m11, float m12, float m13,
-             float m21, float m22, float m23,
-             float m31, float m32, float m33)
+    Matrix4(T m11, T m12, T m13,
+             T m21, T m22, T m23,
+             T m31, T m32, T m33)
     {
         M[0][0] = m11; M[0][1] = m12; M[0][2] = m13; M[0][3] = 0;
         M[1][0] = m21; M[1][1] = m22; M[1][2] = m23; M[1][3] = 0;
@@ -367,7 +385,7 @@ public:
         M[3][0] = 0;   M[3][1] = 0;   M[3][2] = 0;   M[3][3] = 1;
     }
 
-    static const Matrix4f& Identity()  { return IdentityValue; }
+    static const Matrix4& Identity()  { return IdentityValue; }
 
     void SetIdentity()
     {
@@ -378,7 +396,7 @@ public:
     }
 
     // Multiplies two matrices into destination with minimum copying.
-    static Matrix4f& Multiply(Matrix4f* d, const Matrix4f& a, const Matrix4f& b)
+    static Matrix4& Multiply(Matrix4* d, const Matrix4& a, const Matrix4& b)
     {
         OVR_ASSERT((d != &a) && (d != &b));
         int i = 0;
@@ -392,27 +410,27 @@ public:
         return *d;
     }
 
-    Matrix4f operator* (const Matrix4f& b) const
+    Matrix4 operator* (const Matrix4& b) const
     {
-        Matrix4f result(Matrix4f::NoInit);
+        Matrix4 result(Matrix4::NoInit);
         Multiply(&result, *this, b);
         return result;
     }
 
-    Matrix4f& operator*= (const Matrix4f& b)
+    Matrix4& operator*= (const Matrix4& b)
     {
-        return Multiply(this, Matrix4f(*this), b);
+        return Multiply(this, Matrix4(*this), b);
     }
 
-    Matrix4f operator* (float s) const
+    Matrix4 operator* (T s) const
     {
-        return Matrix4f(M[0][0] * s, M[0][1] * s, M[0][2] * s, M[0][3] * s,
+        return Matrix4(M[0][0] * s, M[0][1] * s, M[0][2] * s, M[0][3] * s,
                         M[1][0] * s, M[1][1] * s, M[1][2] * s, M[1][3] * s,
                         M[2][0] * s, M[2][1] * s, M[2][2] * s, M[2][3] * s,
                         M[3][0] * s, M[3][1] * s, M[3][2] * s, M[3][3] * s);
     }
 
-    Matrix4f& operator*= (float s)
+    Matrix4& operator*= (T s)
     {
         M[0][0] *= s; M[0][1] *= s; M[0][2] *= s; M[0][3] *= s;
         M[1][0] *= s; M[1][1] *= s; M[1][2] *= s; M[1][3] *= s;
@@ -421,16 +439,16 @@ public:
         return *this;
     }
 
-    Vector3f Transform(const Vector3f& v) const
+    Vector3<T> Transform(const Vector3<T>& v) const
     {
-        return Vector3f(M[0][0] * v.x + M[0][1] * v.y + M[0][2] * v.z + M[0][3],
+        return Vector3<T>(M[0][0] * v.x + M[0][1] * v.y + M[0][2] * v.z + M[0][3],
                         M[1][0] * v.x + M[1][1] * v.y + M[1][2] * v.z + M[1][3],
                         M[2][0] * v.x + M[2][1] * v.y + M[2][2] * v.z + M[2][3]);
     }
 
-    Matrix4f Transposed() const
+    Matrix4 Transposed() const
     {
-        return Matrix4f(M[0][0], M[1][0], M[2][0], M[3][0],
+        return Matrix4(M[0][0], M[1][0], M[2][0], M[3][0],
                         M[0][1], M[1][1], M[2][1], M[3][1],
                         M[0][2], M[1][2], M[2][2], M[3][2],
                         M[0][3], M[1][3], M[2][3], M[3][3]);
@@ -442,37 +460,37 @@ public:
     }
 
 
-    float SubDet (const int* rows, const int* cols) const
+    T SubDet (const int* rows, const int* cols) const
     {
         return M[rows[0]][cols[0]] * (M[rows[1]][cols[1]] * M[rows[2]][cols[2]] - M[rows[1]][cols[2]] * M[rows[2]][cols[1]])
              - M[rows[0]][cols[1]] * (M[rows[1]][cols[0]] * M[rows[2]][cols[2]] - M[rows[1]][cols[2]] * M[rows[2]][cols[0]])
              + M[rows[0]][cols[2]] * (M[rows[1]][cols[0]] * M[rows[2]][cols[1]] - M[rows[1]][cols[1]] * M[rows[2]][cols[0]]);
     }
 
-    float Cofactor(int I, int J) const
+    T Cofactor(int I, int J) const
     {
         const int indices[4][3] = {{1,2,3},{0,2,3},{0,1,3},{0,1,2}};
         return ((I+J)&1) ? -SubDet(indices[I],indices[J]) : SubDet(indices[I],indices[J]);
     }
 
-    float    Determinant() const
+    T    Determinant() const
     {
         return M[0][0] * Cofactor(0,0) + M[0][1] * Cofactor(0,1) + M[0][2] * Cofactor(0,2) + M[0][3] * Cofactor(0,3);
     }
 
-    Matrix4f Adjugated() const
+    Matrix4 Adjugated() const
     {
-        return Matrix4f(Cofactor(0,0), Cofactor(1,0), Cofactor(2,0), Cofactor(3,0), 
+        return Matrix4(Cofactor(0,0), Cofactor(1,0), Cofactor(2,0), Cofactor(3,0), 
                         Cofactor(0,1), Cofactor(1,1), Cofactor(2,1), Cofactor(3,1), 
                         Cofactor(0,2), Cofactor(1,2), Cofactor(2,2), Cofactor(3,2),
                         Cofactor(0,3), Cofactor(1,3), Cofactor(2,3), Cofactor(3,3));
     }
 
-    Matrix4f Inverted() const
+    Matrix4 Inverted() const
     {
-        float det = Determinant();
+        T det = Determinant();
         assert(det != 0);
-        return Adjugated() * (1.0f/det);
+        return Adjugated() * (T(1.0)/det);
     }
 
     void Invert()
@@ -487,25 +505,25 @@ public:
     // is followed by rotation c around axis A3
     // rotations are CCW or CW (D) in LH or RH coordinate system (S)
     template <Axis A1, Axis A2, Axis A3, RotateDirection D, HandedSystem S>
-    void ToEulerAngles(float *a, float *b, float *c)
+    void ToEulerAngles(T *a, T *b, T *c)
     {
         OVR_COMPILER_ASSERT((A1 != A2) && (A2 != A3) && (A1 != A3));
 
-        float psign = -1.0f;
+        T psign = -T(1.0);
         if (((A1 + 1) % 3 == A2) && ((A2 + 1) % 3 == A3)) // Determine whether even permutation
-        psign = 1.0f;
+        psign = T(1.0);
         
-        float pm = psign*M[A1][A3];
-        if (pm < -1.0f + Math<float>::SingularityRadius)
+        T pm = psign*M[A1][A3];
+        if (pm < -T(1.0) + Math<T>::SingularityRadius)
         { // South pole singularity
-            *a = 0.0f;
-            *b = -S*D*Math<float>::PiOver2;
+            *a = T(0.0);
+            *b = -S*D*Math<T>::PiOver2;
             *c = S*D*atan2( psign*M[A2][A1], M[A2][A2] );
         }
-        else if (pm > 1.0 - Math<float>::SingularityRadius)
+        else if (pm > 1.0 - Math<T>::SingularityRadius)
         { // North pole singularity
-            *a = 0.0f;
-            *b = S*D*Math<float>::PiOver2;
+            *a = T(0.0);
+            *b = S*D*Math<T>::PiOver2;
             *c = S*D*atan2( psign*M[A2][A1], M[A2][A2] );
         }
         else
@@ -525,28 +543,28 @@ public:
     // is followed by rotation c around axis A1
     // rotations are CCW or CW (D) in LH or RH coordinate system (S)
     template <Axis A1, Axis A2, RotateDirection D, HandedSystem S>
-    void ToEulerAnglesABA(float *a, float *b, float *c)
+    void ToEulerAnglesABA(T *a, T *b, T *c)
     {        
          OVR_COMPILER_ASSERT(A1 != A2);
   
         // Determine the axis that was not supplied
         int m = 3 - A1 - A2;
 
-        float psign = -1.0f;
+        T psign = -T(1.0);
         if ((A1 + 1) % 3 == A2) // Determine whether even permutation
-            psign = 1.0f;
+            psign = T(1.0);
 
-        float c2 = M[A1][A1];
-        if (c2 < -1.0 + Math<float>::SingularityRadius)
+        T c2 = M[A1][A1];
+        if (c2 < -1.0 + Math<T>::SingularityRadius)
         { // South pole singularity
-            *a = 0.0f;
-            *b = S*D*Math<float>::Pi;
+            *a = T(0.0);
+            *b = S*D*Math<T>::Pi;
             *c = S*D*atan2( -psign*M[A2][m],M[A2][A2]);
         }
-        else if (c2 > 1.0 - Math<float>::SingularityRadius)
+        else if (c2 > 1.0 - Math<T>::SingularityRadius)
         { // North pole singularity
-            *a = 0.0f;
-            *b = 0.0f;
+            *a = T(0.0);
+            *b = T(0.0);
             *c = S*D*atan2( -psign*M[A2][m],M[A2][A2]);
         }
         else
@@ -561,7 +579,7 @@ public:
     // Creates a matrix that converts the vertices from one coordinate system
     // to another.
     // 
-    static Matrix4f AxisConversion(const WorldAxes& to, const WorldAxes& from)
+    static Matrix4 AxisConversion(const WorldAxes& to, const WorldAxes& from)
     {        
         // Holds axis values from the 'to' structure
         int toArray[3] = { to.XAxis, to.YAxis, to.ZAxis };
@@ -572,58 +590,58 @@ public:
         inv[abs(to.YAxis)] = 1;
         inv[abs(to.ZAxis)] = 2;
 
-        Matrix4f m(0,  0,  0, 
+        Matrix4 m(0,  0,  0, 
                    0,  0,  0,
                    0,  0,  0);
 
         // Only three values in the matrix need to be changed to 1 or -1.
-        m.M[inv[abs(from.XAxis)]][0] = float(from.XAxis/toArray[inv[abs(from.XAxis)]]);
-        m.M[inv[abs(from.YAxis)]][1] = float(from.YAxis/toArray[inv[abs(from.YAxis)]]);
-        m.M[inv[abs(from.ZAxis)]][2] = float(from.ZAxis/toArray[inv[abs(from.ZAxis)]]);
+        m.M[inv[abs(from.XAxis)]][0] = T(from.XAxis/toArray[inv[abs(from.XAxis)]]);
+        m.M[inv[abs(from.YAxis)]][1] = T(from.YAxis/toArray[inv[abs(from.YAxis)]]);
+        m.M[inv[abs(from.ZAxis)]][2] = T(from.ZAxis/toArray[inv[abs(from.ZAxis)]]);
         return m;
     } 
 
 
 
-    static Matrix4f Translation(const Vector3f& v)
+    static Matrix4 Translation(const Vector3<T>& v)
     {
-        Matrix4f t;
+        Matrix4 t;
         t.M[0][3] = v.x;
         t.M[1][3] = v.y;
         t.M[2][3] = v.z;
         return t;
     }
 
-    static Matrix4f Translation(float x, float y, float z = 0.0f)
+    static Matrix4 Translation(T x, T y, T z = T(0.0))
     {
-        Matrix4f t;
+        Matrix4 t;
         t.M[0][3] = x;
         t.M[1][3] = y;
         t.M[2][3] = z;
         return t;
     }
 
-    static Matrix4f Scaling(const Vector3f& v)
+    static Matrix4 Scaling(const Vector3<T>& v)
     {
-        Matrix4f t;
+        Matrix4 t;
         t.M[0][0] = v.x;
         t.M[1][1] = v.y;
         t.M[2][2] = v.z;
         return t;
     }
 
-    static Matrix4f Scaling(float x, float y, float z)
+    static Matrix4 Scaling(T x, T y, T z)
     {
-        Matrix4f t;
+        Matrix4 t;
         t.M[0][0] = x;
         t.M[1][1] = y;
         t.M[2][2] = z;
         return t;
     }
 
-    static Matrix4f Scaling(float s)
+    static Matrix4 Scaling(T s)
     {
-        Matrix4f t;
+        Matrix4 t;
         t.M[0][0] = s;
         t.M[1][1] = s;
         t.M[2][2] = s;
@@ -633,26 +651,28 @@ public:
   
 
     //AnnaSteve : Just for quick testing.  Not for final API.  Need to remove case.
-    static Matrix4f RotationAxis(Axis A, float angle, RotateDirection d, HandedSystem s)
+    static Matrix4 RotationAxis(Axis A, T angle, RotateDirection d, HandedSystem s)
     {
-        float sina = s * d *sin(angle);
-        float cosa = cos(angle);
+        T sina = s * d *sin(angle);
+        T cosa = cos(angle);
         
         switch(A)
         {
         case Axis_X:
-            return Matrix4f(1,  0,     0, 
+            return Matrix4(1,  0,     0, 
                             0,  cosa,  -sina,
                             0,  sina,  cosa);
         case Axis_Y:
-            return Matrix4f(cosa,  0,   sina, 
+            return Matrix4(cosa,  0,   sina, 
                             0,     1,   0,
                             -sina, 0,   cosa);
         case Axis_Z:
-            return Matrix4f(cosa,  -sina,  0, 
+            return Matrix4(cosa,  -sina,  0, 
                             sina,  cosa,   0,
                             0,     0,      1);
         }
+        // Not a valid axis.
+        return Matrix4();
     }
 
 
@@ -663,11 +683,11 @@ public:
     //                        same as looking down from positive axis values towards origin.
     //  LHS: Positive angle values rotate clock-wise (CW), while looking in the
     //       negative axis direction.
-    static Matrix4f RotationX(float angle)
+    static Matrix4 RotationX(T angle)
     {
-        float sina = sin(angle);
-        float cosa = cos(angle);
-        return Matrix4f(1,  0,     0, 
+        T sina = sin(angle);
+        T cosa = cos(angle);
+        return Matrix4(1,  0,     0, 
                         0,  cosa,  -sina,
                         0,  sina,  cosa);
     }
@@ -679,11 +699,11 @@ public:
     //                        same as looking down from positive axis values towards origin.
     //  LHS: Positive angle values rotate clock-wise (CW), while looking in the
     //       negative axis direction.
-    static Matrix4f RotationY(float angle)
+    static Matrix4 RotationY(T angle)
     {
-        float sina = sin(angle);
-        float cosa = cos(angle);
-        return Matrix4f(cosa,  0,   sina, 
+        T sina = sin(angle);
+        T cosa = cos(angle);
+        return Matrix4(cosa,  0,   sina, 
                         0,     1,   0,
                         -sina, 0,   cosa);
     }
@@ -695,11 +715,11 @@ public:
     //                        same as looking down from positive axis values towards origin.
     //  LHS: Positive angle values rotate clock-wise (CW), while looking in the
     //       negative axis direction.
-    static Matrix4f RotationZ(float angle)
+    static Matrix4 RotationZ(T angle)
     {
-        float sina = sin(angle);
-        float cosa = cos(angle);
-        return Matrix4f(cosa,  -sina,  0, 
+        T sina = sin(angle);
+        T cosa = cos(angle);
+        return Matrix4(cosa,  -sina,  0, 
                         sina,  cosa,   0,
                         0,     0,      1);
     }
@@ -709,12 +729,12 @@ public:
     // The resulting matrix points camera from 'eye' towards 'at' direction, with 'up'
     // specifying the up vector. The resulting matrix should be used with PerspectiveRH
     // projection.
-    static Matrix4f LookAtRH(const Vector3f& eye, const Vector3f& at, const Vector3f& up);
+    static Matrix4 LookAtRH(const Vector3<T>& eye, const Vector3<T>& at, const Vector3<T>& up);
 
     // LookAtLH creates a View transformation matrix for left-handed coordinate system.
     // The resulting matrix points camera from 'eye' towards 'at' direction, with 'up'
     // specifying the up vector. 
-    static Matrix4f LookAtLH(const Vector3f& eye, const Vector3f& at, const Vector3f& up);
+    static Matrix4 LookAtLH(const Vector3<T>& eye, const Vector3<T>& at, const Vector3<T>& up);
     
     
     // PerspectiveRH creates a right-handed perspective projection matrix that can be
@@ -726,7 +746,7 @@ public:
     //  zfar   - Absolute value of far  Z clipping clipping range (larger then near).
     // Even though RHS usually looks in the direction of negative Z, positive values
     // are expected for znear and zfar.
-    static Matrix4f PerspectiveRH(float yfov, float aspect, float znear, float zfar);
+    static Matrix4 PerspectiveRH(T yfov, T aspect, T znear, T zfar);
     
     
     // PerspectiveRH creates a left-handed perspective projection matrix that can be
@@ -736,12 +756,42 @@ public:
     //           Note that xfov = yfov * aspect.
     //  znear  - Absolute value of near Z clipping clipping range.
     //  zfar   - Absolute value of far  Z clipping clipping range (larger then near).
-    static Matrix4f PerspectiveLH(float yfov, float aspect, float znear, float zfar);
+    static Matrix4 PerspectiveLH(T yfov, T aspect, T znear, T zfar);
 
 
-    static Matrix4f Ortho2D(float w, float h);
+    static Matrix4 Ortho2D(T w, T h);
 };
 
+// Default-constructed to identity.
+template<class T>
+Matrix4<T> Matrix4<T>::IdentityValue;
+
+#ifdef OVR_MATH_SIMD
+template<>
+inline Matrix4<float>& Matrix4<float>::Multiply(Matrix4<float>* d, const Matrix4<float>& a, const Matrix4<float>& b)
+{
+    OVR_ASSERT((d != &a) && (d != &b));
+    SIMD::Matrix4Multiply(&d->M[0][0], &a.M[0][0], &b.M[0][0]);
+    return *d;
+}
+
+template<>
+inline Matrix4<float> Matrix4<float>::Inverted() const
+{
+    Matrix4<float> result(NoInit);
+    float det = SIMD::Matrix4Inverse(&result.M[0][0], &M[0][0]);
+    assert(det != 0);
+    // result is left unwritten for a singular matrix; give the same inf/NaN
+    // matrix as the scalar version.
+    if (det == 0)
+        return Adjugated() * (1.0f / det);
+    return result;
+}
+#endif
+
+typedef Matrix4<float>  Matrix4f;
+typedef Matrix4<double> Matrix4d;
+
 
 //-------------------------------------------------------------------------------------
 // ***** Quat
@@ -762,6 +812,10 @@ public:
     Quat() : x(0), y(0), z(0), w(1) {}
     Quat(T x_, T y_, T z_, T w_) : x(x_), y(y_), z(z_), w(w_) {}
 
+    // Converts from a quaternion of different precision.
+    template<class U>
+    explicit Quat(const Quat<U>& src) : x(T(src.x)), y(T(src.y)), z(T(src.z)), w(T(src.w)) { }
+
 
     // Constructs rotation quaternion around the axis.
     Quat(const Vector3<T>& axis, T angle)
@@ -789,6 +843,32 @@ public:
         z = v[2];
     }
 
+    // Returns the rotation by |v| radians around the direction of v (the exponential
+    // map), e.g. the rotation of angular velocity v over unit time.
+    // Small rotations, |v| < 0.84 for float and |v| < 0.069 for double, are evaluated
+    // with a series in |v|^2 whose truncation error stays below half an ulp of 1, so
+    // no sqrt, sin or cos is needed; larger ones fall back to sin and cos. This covers
+    // per-sample gyro steps and typical prediction intervals.
+    static Quat FromRotationVector(const Vector3<T>& v)
+    {
+        // s = (|v|/2)^2; the series below is exact to the precision of T for s < limit.
+        const T limit = (sizeof(T) > sizeof(float)) ? T(1.2e-3) : T(0.18);
+        T       s     = v.LengthSq() * T(0.25);
+
+        if (s < limit)
+        {
+            // sin(h)/h and cos(h) for half-angle h, truncated after the s^3 term.
+            T sinc = T(1) - s * (T(1)/6   - s * (T(1)/120 - s * (T(1)/5040)));
+            T c    = T(1) - s * (T(1)/2   - s * (T(1)/24  - s * (T(1)/720)));
+            T k    = sinc * T(0.5);
+            return Quat(v.x * k, v.y * k, v.z * k, c);
+        }
+
+        T angle = sqrt(s) * T(2);
+        T k     = sin(angle * T(0.5)) / angle;
+        return Quat(v.x * k, v.y * k, v.z * k, cos(angle * T(0.5)));
+    }
+
 
     void GetAxisAngle(Vector3<T>* axis, T* angle) const
     {
@@ -866,9 +946,13 @@ public:
     
     // Rotate transforms vector in a manner that matches Matrix rotations (counter-clockwise,
     // assuming negative direction of the axis). Standard formula: q(t) * V * q(t)^-1. 
+    // Expanded into cross/dot products, which avoids the two full quaternion products
+    // and matches the formula for non-unit quaternions as well:
+    //   (w^2 - u.u) V + 2 (u.V) u + 2 w (u x V),  where u = (x, y, z).
     Vector3<T> Rotate(const Vector3<T>& v) const
     {
-        return ((*this * Quat<T>(v.x, v.y, v.z, 0)) * Inverted()).Imag();
+        Vector3<T> u(x, y, z);
+        return v * (w * w - u.LengthSq()) + u * (T(2) * (u * v)) + u.Cross(v) * (T(2) * w);
     }
 
     
@@ -885,16 +969,16 @@ public:
     }
     
     // Converting quaternion to matrix.
-    operator Matrix4f() const
+    operator Matrix4<T>() const
     {
         T ww = w*w;
         T xx = x*x;
         T yy = y*y;
         T zz = z*z;
 
-        return Matrix4f(float(ww + xx - yy - zz),  float(T(2) * (x*y - w*z)), float(T(2) * (x*z + w*y)),
-                        float(T(2) * (x*y + w*z)), float(ww - xx + yy - zz),  float(T(2) * (y*z - w*x)),
-                        float(T(2) * (x*z - w*y)), float(T(2) * (y*z + w*x)), float(ww - xx - yy + zz) );
+        return Matrix4<T>(ww + xx - yy - zz,  T(2) * (x*y - w*z), T(2) * (x*z + w*y),
+                          T(2) * (x*y + w*z), ww - xx + yy - zz,  T(2) * (y*z - w*x),
+                          T(2) * (x*z - w*y), T(2) * (y*z + w*x), ww - xx - yy + zz );
     }
 
     
@@ -0,0 +1,294 @@
+/************************************************************************************
+
+Filename    :   OVR_MathArray.cpp
+Content     :   Structure-of-arrays containers for batch vector and quaternion math
+Created     :   October 19, 2026
+Authors     :
+
+Copyright   :   Copyright 2013 Oculus VR, Inc. All Rights reserved.
+
+Use of this software is subject to the terms of the Oculus license
+agreement provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+*************************************************************************************/
+
+#include "OVR_MathArray.h"
+
+#include <string.h>
+
+namespace OVR {
+
+// Below this angle between the endpoints Slerp uses plain linear weights.
+static const float SlerpMinAngle = 1e-5f;
+
+#ifdef OVR_MATH_SIMD
+
+using namespace SIMD;
+
+// The 3x4 part of a Matrix4f with every element broadcast, loaded once per array so
+// that stores to the element arrays can't force it to be re-read.
+struct SplatMatrix
+{
+    Vec4 M[3][4];
+
+    SplatMatrix(const Matrix4f& m, bool translate)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 3; c++)
+                M[r][c] = Splat(m.M[r][c]);
+            M[r][3] = Splat(translate ? m.M[r][3] : 0.0f);
+        }
+    }
+};
+
+// Transforms four points held in x, y, z.
+static inline void transform4(float* x, float* y, float* z, const SplatMatrix& m)
+{
+    Vec4 vx = Load(x), vy = Load(y), vz = Load(z);
+    Vec4 rx = MulAdd(m.M[0][2], vz, MulAdd(m.M[0][1], vy, Mul(m.M[0][0], vx)));
+    Vec4 ry = MulAdd(m.M[1][2], vz, MulAdd(m.M[1][1], vy, Mul(m.M[1][0], vx)));
+    Vec4 rz = MulAdd(m.M[2][2], vz, MulAdd(m.M[2][1], vy, Mul(m.M[2][0], vx)));
+    Store(x, Add(rx, m.M[0][3]));
+    Store(y, Add(ry, m.M[1][3]));
+    Store(z, Add(rz, m.M[2][3]));
+}
+
+static void transformArray(float* x, float* y, float* z, UPInt count,
+                           const Matrix4f& matrix, bool translate)
+{
+    SplatMatrix m(matrix, translate);
+
+    UPInt i = 0;
+    for (; i + 4 <= count; i += 4)
+        transform4(x + i, y + i, z + i, m);
+
+    if (i < count)
+    {
+        // Run the remainder through the same kernel so every element is rounded alike.
+        UPInt n = count - i;
+        float tx[4] = { 0 }, ty[4] = { 0 }, tz[4] = { 0 };
+        memcpy(tx, x + i, n * sizeof(float));
+        memcpy(ty, y + i, n * sizeof(float));
+        memcpy(tz, z + i, n * sizeof(float));
+        transform4(tx, ty, tz, m);
+        memcpy(x + i, tx, n * sizeof(float));
+        memcpy(y + i, ty, n * sizeof(float));
+        memcpy(z + i, tz, n * sizeof(float));
+    }
+}
+
+static inline void normalize4(float* x, float* y, float* z, float* w)
+{
+    Vec4 vx = Load(x), vy = Load(y), vz = Load(z), vw = Load(w);
+    Vec4 lenSq = Mul(vx, vx);
+    lenSq = MulAdd(vy, vy, lenSq);
+    lenSq = MulAdd(vz, vz, lenSq);
+    lenSq = MulAdd(vw, vw, lenSq);
+    Vec4 rcp = Div(Splat(1.0f), Sqrt(lenSq));
+    Store(x, Mul(vx, rcp));
+    Store(y, Mul(vy, rcp));
+    Store(z, Mul(vz, rcp));
+    Store(w, Mul(vw, rcp));
+}
+
+// acos(x) for x in [0, 1]; Abramowitz and Stegun 4.4.46, error below 2e-8.
+static inline Vec4 acos01(Vec4 x)
+{
+    Vec4 p = Splat(-0.0012624911f);
+    p = MulAdd(p, x, Splat( 0.0066700901f));
+    p = MulAdd(p, x, Splat(-0.0170881256f));
+    p = MulAdd(p, x, Splat( 0.0308918810f));
+    p = MulAdd(p, x, Splat(-0.0501743046f));
+    p = MulAdd(p, x, Splat( 0.0889789874f));
+    p = MulAdd(p, x, Splat(-0.2145988016f));
+    p = MulAdd(p, x, Splat( 1.5707963050f));
+    return Mul(p, Sqrt(Sub(Splat(1.0f), x)));
+}
+
+// sin(x) for x in [0, Pi/2]; Taylor series to x^11, error below 6e-8.
+static inline Vec4 sinHalfPi(Vec4 x)
+{
+    Vec4 x2 = Mul(x, x);
+    Vec4 p = Splat(-1.0f / 39916800.0f);
+    p = MulAdd(p, x2, Splat( 1.0f / 362880.0f));
+    p = MulAdd(p, x2, Splat(-1.0f / 5040.0f));
+    p = MulAdd(p, x2, Splat( 1.0f / 120.0f));
+    p = MulAdd(p, x2, Splat(-1.0f / 6.0f));
+    p = MulAdd(p, x2, Splat( 1.0f));
+    return Mul(p, x);
+}
+
+// Slerps four quaternion pairs; a* and d* may be the same arrays.
+static inline void slerp4(float* dx, float* dy, float* dz, float* dw,
+                          const float* ax, const float* ay, const float* az, const float* aw,
+                          const float* bx, const float* by, const float* bz, const float* bw,
+                          float t)
+{
+    Vec4 qax = Load(ax), qay = Load(ay), qaz = Load(az), qaw = Load(aw);
+    Vec4 qbx = Load(bx), qby = Load(by), qbz = Load(bz), qbw = Load(bw);
+
+    Vec4 dot = Mul(qax, qbx);
+    dot = MulAdd(qay, qby, dot);
+    dot = MulAdd(qaz, qbz, dot);
+    dot = MulAdd(qaw, qbw, dot);
+
+    // q and -q are the same rotation; flip b where needed to take the shorter arc.
+    Vec4 flip = Less(dot, Splat(0.0f));
+    qbx = NegateIf(flip, qbx);
+    qby = NegateIf(flip, qby);
+    qbz = NegateIf(flip, qbz);
+    qbw = NegateIf(flip, qbw);
+    dot = Min(NegateIf(flip, dot), Splat(1.0f));
+
+    Vec4 vt     = Splat(t);
+    Vec4 vs     = Splat(1.0f - t);
+    Vec4 angle  = acos01(dot);
+    Vec4 rcpSin = Div(Splat(1.0f), sinHalfPi(angle));
+    Vec4 large  = Greater(angle, Splat(SlerpMinAngle));
+    Vec4 wa     = Select(large, Mul(sinHalfPi(Mul(vs, angle)), rcpSin), vs);
+    Vec4 wb     = Select(large, Mul(sinHalfPi(Mul(vt, angle)), rcpSin), vt);
+
+    Store(dx, MulAdd(qax, wa, Mul(qbx, wb)));
+    Store(dy, MulAdd(qay, wa, Mul(qby, wb)));
+    Store(dz, MulAdd(qaz, wa, Mul(qbz, wb)));
+    Store(dw, MulAdd(qaw, wa, Mul(qbw, wb)));
+}
+
+#else // OVR_MATH_SIMD
+
+static void transformArray(float* x, float* y, float* z, UPInt count,
+                           const Matrix4f& m, bool translate)
+{
+    float tx = translate ? m.M[0][3] : 0.0f;
+    float ty = translate ? m.M[1][3] : 0.0f;
+    float tz = translate ? m.M[2][3] : 0.0f;
+
+    for (UPInt i = 0; i < count; i++)
+    {
+        float vx = x[i], vy = y[i], vz = z[i];
+        x[i] = m.M[0][0] * vx + m.M[0][1] * vy + m.M[0][2] * vz + tx;
+        y[i] = m.M[1][0] * vx + m.M[1][1] * vy + m.M[1][2] * vz + ty;
+        z[i] = m.M[2][0] * vx + m.M[2][1] * vy + m.M[2][2] * vz + tz;
+    }
+}
+
+#endif // OVR_MATH_SIMD
+
+
+//-------------------------------------------------------------------------------------
+// ***** Vector3fArray
+
+void Vector3fArray::Rotate(const Quatf& q)
+{
+    // One matrix build amortized over the array is cheaper than per-element Rotate.
+    Matrix4f m = q;
+    transformArray(GetX(), GetY(), GetZ(), GetSize(), m, false);
+}
+
+void Vector3fArray::Transform(const Matrix4f& m)
+{
+    transformArray(GetX(), GetY(), GetZ(), GetSize(), m, true);
+}
+
+
+//-------------------------------------------------------------------------------------
+// ***** QuatfArray
+
+void QuatfArray::Normalize()
+{
+    float* x = GetX();
+    float* y = GetY();
+    float* z = GetZ();
+    float* w = GetW();
+    UPInt  count = GetSize();
+    UPInt  i = 0;
+
+#ifdef OVR_MATH_SIMD
+    for (; i + 4 <= count; i += 4)
+        normalize4(x + i, y + i, z + i, w + i);
+#endif
+
+    for (; i < count; i++)
+    {
+        Quatf q(x[i], y[i], z[i], w[i]);
+        q.Normalize();
+        x[i] = q.x; y[i] = q.y; z[i] = q.z; w[i] = q.w;
+    }
+}
+
+void QuatfArray::Slerp(const QuatfArray& a, const QuatfArray& b, float t)
+{
+    OVR_ASSERT(a.GetSize() == b.GetSize());
+    UPInt count = a.GetSize();
+    Resize(count);
+
+    float* dx = GetX();
+    float* dy = GetY();
+    float* dz = GetZ();
+    float* dw = GetW();
+    UPInt  i = 0;
+
+#ifdef OVR_MATH_SIMD
+    for (; i + 4 <= count; i += 4)
+    {
+        slerp4(dx + i, dy + i, dz + i, dw + i,
+               a.GetX() + i, a.GetY() + i, a.GetZ() + i, a.GetW() + i,
+               b.GetX() + i, b.GetY() + i, b.GetZ() + i, b.GetW() + i, t);
+    }
+
+    if (i < count)
+    {
+        // Pad the remainder to a full group so it goes through the same kernel.
+        UPInt n = count - i;
+        float ta[4][4], tb[4][4];
+        const float* pa[4] = { a.GetX(), a.GetY(), a.GetZ(), a.GetW() };
+        const float* pb[4] = { b.GetX(), b.GetY(), b.GetZ(), b.GetW() };
+        float*       pd[4] = { dx, dy, dz, dw };
+        for (int c = 0; c < 4; c++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                ta[c][j] = (c == 3) ? 1.0f : 0.0f;
+                tb[c][j] = ta[c][j];
+            }
+            memcpy(ta[c], pa[c] + i, n * sizeof(float));
+            memcpy(tb[c], pb[c] + i, n * sizeof(float));
+        }
+        slerp4(ta[0], ta[1], ta[2], ta[3], ta[0], ta[1], ta[2], ta[3],
+               tb[0], tb[1], tb[2], tb[3], t);
+        for (int c = 0; c < 4; c++)
+            memcpy(pd[c] + i, ta[c], n * sizeof(float));
+    }
+#else
+    for (; i < count; i++)
+    {
+        Quatf qa = a.Get(i);
+        Quatf qb = b.Get(i);
+        float dot = qa.x * qb.x + qa.y * qb.y + qa.z * qb.z + qa.w * qb.w;
+        if (dot < 0)
+        {
+            qb  = qb * -1.0f;
+            dot = -dot;
+        }
+        if (dot > 1.0f)
+            dot = 1.0f;
+
+        float angle = acosf(dot);
+        float wa    = 1.0f - t;
+        float wb    = t;
+        if (angle > SlerpMinAngle)
+        {
+            float rcpSin = 1.0f / sinf(angle);
+            wa = sinf(wa * angle) * rcpSin;
+            wb = sinf(wb * angle) * rcpSin;
+        }
+
+        Quatf q = qa * wa + qb * wb;
+        dx[i] = q.x; dy[i] = q.y; dz[i] = q.z; dw[i] = q.w;
+    }
+#endif
+}
+
+} // namespace OVR
@@ -0,0 +1,109 @@
+/************************************************************************************
+
+PublicHeader:   None
+Filename    :   OVR_MathArray.h
+Content     :   Structure-of-arrays containers for batch vector and quaternion math
+Created     :   October 19, 2026
+Authors     :
+
+Copyright   :   Copyright 2013 Oculus VR, Inc. All Rights reserved.
+
+Use of this software is subject to the terms of the Oculus license
+agreement provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+*************************************************************************************/
+
+#ifndef OVR_MathArray_h
+#define OVR_MathArray_h
+
+#include "OVR_Math.h"
+#include "OVR_Array.h"
+
+namespace OVR {
+
+//-------------------------------------------------------------------------------------
+// ***** Vector3fArray
+//
+// Vector3fArray stores a sequence of Vector3f as separate x, y and z arrays, so that
+// batch operations can process four elements at a time with SIMD. Use it instead of
+// Array<Vector3f> for vertex data, ray fans or recorded sample streams that are
+// transformed as a whole.
+
+class Vector3fArray : public NewOverrideBase
+{
+public:
+    Vector3fArray() { }
+    explicit Vector3fArray(UPInt size) { Resize(size); }
+
+    UPInt    GetSize() const                    { return X.GetSize(); }
+    void     Resize(UPInt size)                 { X.Resize(size); Y.Resize(size); Z.Resize(size); }
+    void     Clear()                            { Resize(0); }
+
+    Vector3f Get(UPInt i) const                 { return Vector3f(X[i], Y[i], Z[i]); }
+    void     Set(UPInt i, const Vector3f& v)    { X[i] = v.x; Y[i] = v.y; Z[i] = v.z; }
+    void     PushBack(const Vector3f& v)        { X.PushBack(v.x); Y.PushBack(v.y); Z.PushBack(v.z); }
+
+    // Component arrays, GetSize() elements each. Invalidated by resizing.
+    float*       GetX()                         { return X.GetDataPtr(); }
+    float*       GetY()                         { return Y.GetDataPtr(); }
+    float*       GetZ()                         { return Z.GetDataPtr(); }
+    const float* GetX() const                   { return X.GetDataPtr(); }
+    const float* GetY() const                   { return Y.GetDataPtr(); }
+    const float* GetZ() const                   { return Z.GetDataPtr(); }
+
+    // Replaces every element v with q.Rotate(v).
+    void     Rotate(const Quatf& q);
+    // Replaces every element v with m.Transform(v).
+    void     Transform(const Matrix4f& m);
+
+private:
+    ArrayPOD<float> X, Y, Z;
+};
+
+
+//-------------------------------------------------------------------------------------
+// ***** QuatfArray
+//
+// QuatfArray stores a sequence of Quatf as separate x, y, z and w arrays.
+
+class QuatfArray : public NewOverrideBase
+{
+public:
+    QuatfArray() { }
+    explicit QuatfArray(UPInt size) { Resize(size); }
+
+    UPInt    GetSize() const                    { return X.GetSize(); }
+    void     Resize(UPInt size)                 { X.Resize(size); Y.Resize(size); Z.Resize(size); W.Resize(size); }
+    void     Clear()                            { Resize(0); }
+
+    Quatf    Get(UPInt i) const                 { return Quatf(X[i], Y[i], Z[i], W[i]); }
+    void     Set(UPInt i, const Quatf& q)       { X[i] = q.x; Y[i] = q.y; Z[i] = q.z; W[i] = q.w; }
+    void     PushBack(const Quatf& q)           { X.PushBack(q.x); Y.PushBack(q.y); Z.PushBack(q.z); W.PushBack(q.w); }
+
+    // Component arrays, GetSize() elements each. Invalidated by resizing.
+    float*       GetX()                         { return X.GetDataPtr(); }
+    float*       GetY()                         { return Y.GetDataPtr(); }
+    float*       GetZ()                         { return Z.GetDataPtr(); }
+    float*       GetW()                         { return W.GetDataPtr(); }
+    const float* GetX() const                   { return X.GetDataPtr(); }
+    const float* GetY() const                   { return Y.GetDataPtr(); }
+    const float* GetZ() const                   { return Z.GetDataPtr(); }
+    const float* GetW() const                   { return W.GetDataPtr(); }
+
+    // Normalizes every quaternion.
+    void     Normalize();
+
+    // Sets element i to the spherical interpolation from a[i] to b[i] at t in [0, 1],
+    // taking the shorter arc. a and b must be normalized and of the same size; either
+    // may be this array. The SIMD path evaluates acos and sin with polynomials
+    // accurate to about 1e-6.
+    void     Slerp(const QuatfArray& a, const QuatfArray& b, float t);
+
+private:
+    ArrayPOD<float> X, Y, Z, W;
+};
+
+} // namespace OVR
+
+#endif // OVR_MathArray_h
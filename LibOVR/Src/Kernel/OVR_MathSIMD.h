@@ -0,0 +1,183 @@
+/************************************************************************************
+
+PublicHeader:   None
+Filename    :   OVR_MathSIMD.h
+Content     :   4-wide float vector primitives and SIMD kernels used by OVR_Math.h
+Created     :   October 19, 2026
+Authors     :
+
+Copyright   :   Copyright 2013 Oculus VR, Inc. All Rights reserved.
+
+Use of this software is subject to the terms of the Oculus license
+agreement provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+*************************************************************************************/
+
+#ifndef OVR_MathSIMD_h
+#define OVR_MathSIMD_h
+
+#include "OVR_Types.h"
+
+// OVR_MATH_SIMD is defined when the float kernels below are available; OVR_Math.h
+// falls back to its scalar code otherwise. Define OVR_MATH_NO_SIMD to force scalar.
+//
+// The kernels are written only in terms of the Vec4 primitives, so adding another
+// instruction set (such as OVR_CPU_ARM_NEON) means providing those primitives.
+#if defined(OVR_CPU_SSE) && !defined(OVR_MATH_NO_SIMD)
+#  include <xmmintrin.h>
+#  define OVR_MATH_SIMD
+#endif
+
+#ifdef OVR_MATH_SIMD
+
+namespace OVR { namespace SIMD {
+
+//-------------------------------------------------------------------------------------
+// ***** Vec4 primitives
+
+typedef __m128 Vec4;
+
+inline Vec4  Load(const float* p)                   { return _mm_loadu_ps(p); }
+inline void  Store(float* p, Vec4 v)                { _mm_storeu_ps(p, v); }
+inline Vec4  Set(float x, float y, float z, float w){ return _mm_setr_ps(x, y, z, w); }
+inline Vec4  Splat(float s)                         { return _mm_set1_ps(s); }
+inline float GetX(Vec4 v)                           { return _mm_cvtss_f32(v); }
+
+inline Vec4  Add(Vec4 a, Vec4 b)                    { return _mm_add_ps(a, b); }
+inline Vec4  Sub(Vec4 a, Vec4 b)                    { return _mm_sub_ps(a, b); }
+inline Vec4  Mul(Vec4 a, Vec4 b)                    { return _mm_mul_ps(a, b); }
+inline Vec4  Div(Vec4 a, Vec4 b)                    { return _mm_div_ps(a, b); }
+// a * b + c, rounded after the multiply just like the scalar expression.
+inline Vec4  MulAdd(Vec4 a, Vec4 b, Vec4 c)         { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+inline Vec4  Sqrt(Vec4 v)                           { return _mm_sqrt_ps(v); }
+inline Vec4  Min(Vec4 a, Vec4 b)                    { return _mm_min_ps(a, b); }
+inline Vec4  Max(Vec4 a, Vec4 b)                    { return _mm_max_ps(a, b); }
+
+// Comparisons return a mask with all bits of a lane set where the condition holds.
+inline Vec4  Less(Vec4 a, Vec4 b)                   { return _mm_cmplt_ps(a, b); }
+inline Vec4  Greater(Vec4 a, Vec4 b)                { return _mm_cmpgt_ps(a, b); }
+// Picks lanes of a where mask is set and lanes of b elsewhere.
+inline Vec4  Select(Vec4 mask, Vec4 a, Vec4 b)      { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+// Flips the sign of the lanes where mask is set.
+inline Vec4  NegateIf(Vec4 mask, Vec4 v)            { return _mm_xor_ps(v, _mm_and_ps(mask, _mm_set1_ps(-0.0f))); }
+
+// Result lanes are v[X], v[Y], v[Z], v[W].
+template<int X, int Y, int Z, int W>
+inline Vec4  Swizzle(Vec4 v)                        { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(W, Z, Y, X)); }
+// Result lanes are a[X], a[Y], b[Z], b[W].
+template<int X, int Y, int Z, int W>
+inline Vec4  Shuffle(Vec4 a, Vec4 b)                { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(W, Z, Y, X)); }
+
+
+//-------------------------------------------------------------------------------------
+// ***** Kernels
+//
+// Matrices are 16 row-major floats, matching the memory layout of Matrix4f.
+//
+// Only operations that are never slower than the scalar code are routed here; single
+// vector transforms and quaternion products are short enough that shuffling them into
+// 4-wide registers costs more than it saves.
+
+// d = a * b; d must not alias a or b. Terms are summed in the same order as the
+// scalar code, so the result is identical.
+inline void Matrix4Multiply(float* d, const float* a, const float* b)
+{
+    Vec4 b0 = Load(b), b1 = Load(b + 4), b2 = Load(b + 8), b3 = Load(b + 12);
+
+    for (int i = 0; i < 16; i += 4)
+    {
+        Vec4 r = Mul(Splat(a[i]), b0);
+        r = MulAdd(Splat(a[i + 1]), b1, r);
+        r = MulAdd(Splat(a[i + 2]), b2, r);
+        r = MulAdd(Splat(a[i + 3]), b3, r);
+        Store(d + i, r);
+    }
+}
+
+// Writes the inverse of s into d (which may alias s) and returns the determinant.
+// d is left unmodified if the determinant is zero.
+// Cramer's rule with 2x2 sub-determinants shared between cofactors.
+inline float Matrix4Inverse(float* d, const float* s)
+{
+    Vec4 a0 = Load(s), a1 = Load(s + 4), a2 = Load(s + 8), a3 = Load(s + 12);
+
+    // Transposed, with the odd rows rotated by two lanes.
+    Vec4 t    = Shuffle<0, 1, 0, 1>(a0, a1);
+    Vec4 row1 = Shuffle<0, 1, 0, 1>(a2, a3);
+    Vec4 row0 = Shuffle<0, 2, 0, 2>(t, row1);
+    row1      = Shuffle<1, 3, 1, 3>(row1, t);
+    t         = Shuffle<2, 3, 2, 3>(a0, a1);
+    Vec4 row3 = Shuffle<2, 3, 2, 3>(a2, a3);
+    Vec4 row2 = Shuffle<0, 2, 0, 2>(t, row3);
+    row3      = Shuffle<1, 3, 1, 3>(row3, t);
+
+    Vec4 minor0, minor1, minor2, minor3;
+
+    t      = Swizzle<1, 0, 3, 2>(Mul(row2, row3));
+    minor0 = Mul(row1, t);
+    minor1 = Mul(row0, t);
+    t      = Swizzle<2, 3, 0, 1>(t);
+    minor0 = Sub(Mul(row1, t), minor0);
+    minor1 = Sub(Mul(row0, t), minor1);
+    minor1 = Swizzle<2, 3, 0, 1>(minor1);
+
+    t      = Swizzle<1, 0, 3, 2>(Mul(row1, row2));
+    minor0 = MulAdd(row3, t, minor0);
+    minor3 = Mul(row0, t);
+    t      = Swizzle<2, 3, 0, 1>(t);
+    minor0 = Sub(minor0, Mul(row3, t));
+    minor3 = Sub(Mul(row0, t), minor3);
+    minor3 = Swizzle<2, 3, 0, 1>(minor3);
+
+    t      = Swizzle<1, 0, 3, 2>(Mul(Swizzle<2, 3, 0, 1>(row1), row3));
+    row2   = Swizzle<2, 3, 0, 1>(row2);
+    minor0 = MulAdd(row2, t, minor0);
+    minor2 = Mul(row0, t);
+    t      = Swizzle<2, 3, 0, 1>(t);
+    minor0 = Sub(minor0, Mul(row2, t));
+    minor2 = Sub(Mul(row0, t), minor2);
+    minor2 = Swizzle<2, 3, 0, 1>(minor2);
+
+    t      = Swizzle<1, 0, 3, 2>(Mul(row0, row1));
+    minor2 = MulAdd(row3, t, minor2);
+    minor3 = Sub(Mul(row2, t), minor3);
+    t      = Swizzle<2, 3, 0, 1>(t);
+    minor2 = Sub(Mul(row3, t), minor2);
+    minor3 = Sub(minor3, Mul(row2, t));
+
+    t      = Swizzle<1, 0, 3, 2>(Mul(row0, row3));
+    minor1 = Sub(minor1, Mul(row2, t));
+    minor2 = MulAdd(row1, t, minor2);
+    t      = Swizzle<2, 3, 0, 1>(t);
+    minor1 = MulAdd(row2, t, minor1);
+    minor2 = Sub(minor2, Mul(row1, t));
+
+    t      = Swizzle<1, 0, 3, 2>(Mul(row0, row2));
+    minor1 = MulAdd(row3, t, minor1);
+    minor3 = Sub(minor3, Mul(row1, t));
+    t      = Swizzle<2, 3, 0, 1>(t);
+    minor1 = Sub(minor1, Mul(row3, t));
+    minor3 = MulAdd(row1, t, minor3);
+
+    Vec4 det = Mul(row0, minor0);
+    det = Add(Swizzle<2, 3, 0, 1>(det), det);
+    det = Add(Swizzle<1, 0, 3, 2>(det), det);
+
+    float determinant = GetX(det);
+    if (determinant == 0)
+        return 0;
+
+    Vec4 rcp = Splat(1.0f / determinant);
+    Store(d,      Mul(minor0, rcp));
+    Store(d + 4,  Mul(minor1, rcp));
+    Store(d + 8,  Mul(minor2, rcp));
+    Store(d + 12, Mul(minor3, rcp));
+    return determinant;
+}
+
+}} // namespace OVR::SIMD
+
+#endif // OVR_MATH_SIMD
+
+#endif // OVR_MathSIMD_h
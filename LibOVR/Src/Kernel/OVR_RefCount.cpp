@@ -65,13 +65,17 @@ void RefCountNTSImplCore::reportInvalidDelete(void *pmem)
 
 // *** Thread-Safe RefCountImpl
 
+// Increments need no ordering, since the caller already holds a reference. The
+// decrement that reaches zero must see all writes made through other references
+// before they were released, so decrements are Sync.
+
 void    RefCountImpl::AddRef()
 {
     AtomicOps<int>::ExchangeAdd_NoSync(&RefCount, 1);
 }
 void    RefCountImpl::Release()
 {
-    if ((AtomicOps<int>::ExchangeAdd_NoSync(&RefCount, -1) - 1) == 0)
+    if ((AtomicOps<int>::ExchangeAdd_Sync(&RefCount, -1) - 1) == 0)
         delete this;
 }
 
@@ -83,7 +87,7 @@ void    RefCountVImpl::AddRef()
 }
 void    RefCountVImpl::Release()
 {
-    if ((AtomicOps<int>::ExchangeAdd_NoSync(&RefCount, -1) - 1) == 0)
+    if ((AtomicOps<int>::ExchangeAdd_Sync(&RefCount, -1) - 1) == 0)
         delete this;
 }
 
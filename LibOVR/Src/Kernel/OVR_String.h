@@ -77,7 +77,7 @@ protected:
         // checking against 0 needs to made an atomic operation.
         void    Release()
         {
-            if ((AtomicOps<SInt32>::ExchangeAdd_NoSync(&RefCount, -1) - 1) == 0)
+            if ((AtomicOps<SInt32>::ExchangeAdd_Sync(&RefCount, -1) - 1) == 0)
                 OVR_FREE(this);
         }
 
@@ -0,0 +1,477 @@
+/************************************************************************************
+
+Filename    :   OVR_TaskScheduler.cpp
+Content     :   Work-stealing task scheduler, task groups and ParallelFor
+Created     :   October 19, 2026
+Notes       :
+
+Copyright   :   Copyright 2013 Oculus VR, Inc. All Rights reserved.
+
+Use of this software is subject to the terms of the Oculus license
+agreement provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+************************************************************************************/
+
+#include "OVR_TaskScheduler.h"
+
+#ifdef OVR_ENABLE_THREADS
+
+namespace OVR {
+
+// Number of failed attempts to find work before a thread goes to sleep.
+static const unsigned IdleSpinCount = 256;
+// Waits nested deeper than this on a worker don't steal. Each stolen task can add
+// the depth of its own task tree to the stack.
+static const int      MaxStealDepth = 4;
+
+static inline void spinPause()
+{
+#if defined(OVR_OS_WIN32)
+    YieldProcessor();
+#elif defined(OVR_CPU_X86) || defined(OVR_CPU_X86_64)
+    asm volatile("pause\n" ::: "memory");
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** TaskDeque
+
+// TaskDeque is a fixed-size Chase-Lev deque. The owning worker pushes and pops at
+// Bottom without locking; other threads steal at Top with a compare-and-set,
+// which also settles the race for the last task between the owner and a thief.
+
+class TaskDeque : public NewOverrideBase
+{
+    enum { Capacity = 4096, Mask = Capacity - 1 };
+
+    AtomicInt<UPInt>    Top;
+    UByte               Pad0[64 - sizeof(AtomicInt<UPInt>)];
+    AtomicInt<UPInt>    Bottom;
+    UByte               Pad1[64 - sizeof(AtomicInt<UPInt>)];
+    Task* volatile      Tasks[Capacity];
+
+public:
+    // Owner only. Bottom when the task now executing on the owner started; tasks
+    // below it belong to the tasks that are waiting further up the stack.
+    UPInt               TaskBase;
+    // Number of TaskGroup::Wait calls in progress on the owner thread.
+    int                 WaitDepth;
+#ifdef OVR_BUILD_DEBUG
+    // Owner only; task now executing on the owner.
+    Task*               pCurrent;
+#endif
+
+    TaskDeque() : Top(0), Bottom(0), TaskBase(0), WaitDepth(0)
+    {
+#ifdef OVR_BUILD_DEBUG
+        pCurrent = 0;
+#endif
+    }
+
+    bool    IsEmpty() const
+    { return (SPInt)(Bottom.Load_Acquire() - Top.Load_Acquire()) <= 0; }
+
+    UPInt   GetBottom() const   { return Bottom; }
+
+    // Owner only; returns 'false' if the deque is full.
+    bool    Push(Task* task)
+    {
+        UPInt b = Bottom;
+        if ((SPInt)(b - Top.Load_Acquire()) >= Capacity)
+            return false;
+        Tasks[b & Mask] = task;
+        // Full barrier, so that the check for sleeping workers that follows
+        // can't be ordered before the task is visible.
+        Bottom.Exchange_Sync(b + 1);
+        return true;
+    }
+
+    // Owner only; takes the most recently pushed task, unless it is below TaskBase.
+    Task*   Pop()
+    {
+        if ((SPInt)(Bottom - TaskBase) <= 0)
+            return 0;
+
+        UPInt b = Bottom - 1;
+        Bottom.Exchange_Sync(b);
+        UPInt t = Top.Load_Acquire();
+
+        if ((SPInt)(b - t) < 0)
+        {
+            Bottom.Store_Release(t);
+            return 0;
+        }
+
+        Task* task = Tasks[b & Mask];
+        if (b == t)
+        {
+            // Last task; a thief may be taking it as well.
+            if (!Top.CompareAndSet_Sync(t, t + 1))
+                task = 0;
+            Bottom.Store_Release(t + 1);
+        }
+        return task;
+    }
+
+    // Any thread; takes the oldest task.
+    Task*   Steal()
+    {
+        UPInt t = Top.Load_Acquire();
+        UPInt b = Bottom.Load_Acquire();
+        if ((SPInt)(b - t) <= 0)
+            return 0;
+
+        Task* task = Tasks[t & Mask];
+        if (!Top.CompareAndSet_Sync(t, t + 1))
+            return 0;
+        return task;
+    }
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** TaskWorker
+
+class TaskWorker : public Thread
+{
+    TaskScheduler*  pScheduler;
+    int             Index;
+
+public:
+    TaskWorker(TaskScheduler* scheduler, int index)
+        : Thread(1024 * 1024), pScheduler(scheduler), Index(index) { }
+
+    virtual int Run()
+    {
+        SetThreadName("OVR::TaskWorker");
+        pScheduler->workerRun(Index);
+        return 0;
+    }
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** TaskGroup
+
+void TaskGroup::Run(Task* task)
+{
+    OVR_ASSERT(!task->pGroup || task->pGroup == this);
+    task->pGroup = this;
+
+#ifdef OVR_BUILD_DEBUG
+    // Tasks of the group may add to it from anywhere; others must all come from
+    // the task that will wait.
+    int   worker  = pScheduler->getWorkerIndex();
+    Task* current = pScheduler->getCurrentTask(worker);
+    if (HasOwner)
+    {
+        OVR_ASSERT((current && (current->pGroup == this)) ||
+                   ((OwnerWorker == worker) && (pOwnerTask == current)));
+    }
+    else
+    {
+        HasOwner    = true;
+        OwnerWorker = worker;
+        pOwnerTask  = current;
+    }
+#endif
+
+    // Published by the push that follows.
+    State.ExchangeAdd_NoSync(TaskCountOne);
+    pScheduler->push(task);
+}
+
+void TaskGroup::finishTask()
+{
+    // Unless the waiter has announced that it sleeps, it may return and destroy
+    // the group as soon as the count drops to zero, so this must be the last use.
+    if (State.ExchangeAdd_Sync((UPInt)0 - TaskCountOne) == (TaskCountOne | WaiterSleeping))
+        pWaitEvent->Signal();
+}
+
+void TaskGroup::Wait()
+{
+    int      worker = pScheduler->getWorkerIndex();
+    unsigned idle   = 0;
+    bool     steal  = false;
+    bool     help   = true;
+
+#ifdef OVR_BUILD_DEBUG
+    // See the TaskGroup notes; otherwise this may wait forever.
+    OVR_ASSERT(!HasOwner || ((OwnerWorker == worker) &&
+                             (pOwnerTask == pScheduler->getCurrentTask(worker))));
+#endif
+
+    if (worker >= 0)
+        steal = (++pScheduler->Deques[worker]->WaitDepth <= MaxStealDepth);
+    else if ((help = !pScheduler->isHelping()) == true)
+        pScheduler->Helping.Get() = true;
+
+    while (!IsDone())
+    {
+        if (help && pScheduler->runOneTask(worker, steal))
+        {
+            idle = 0;
+            continue;
+        }
+        if (++idle < IdleSpinCount)
+        {
+            spinPause();
+            continue;
+        }
+
+        // Nothing left to help with; sleep until the last task finishes.
+        CompletionEvent done;
+        pWaitEvent = &done;
+        UPInt state = State.Load_Acquire();
+        if ((state >= TaskCountOne) && State.CompareAndSet_Sync(state, state | WaiterSleeping))
+        {
+            done.Wait();
+            State = 0;
+        }
+        pWaitEvent = 0;
+        idle = 0;
+    }
+
+    if (worker >= 0)
+        pScheduler->Deques[worker]->WaitDepth--;
+    else if (help)
+        pScheduler->Helping.Get() = false;
+
+#ifdef OVR_BUILD_DEBUG
+    // The group may be reused from elsewhere once it is done.
+    HasOwner = false;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** TaskScheduler
+
+TaskScheduler::TaskScheduler(int workerCount)
+    : WorkerCount((workerCount > 0) ? workerCount : Thread::GetCPUCount()),
+      SharedHead(0), SharedCount(0), SleepingWorkers(0), Exiting(false),
+      RunningWorkers(0)
+{
+    if (WorkerCount < 1)
+        WorkerCount = 1;
+
+    int threadCount = WorkerCount - 1;
+    RunningWorkers  = threadCount;
+    Deques.Resize(threadCount);
+    for (int i = 0; i < threadCount; i++)
+        Deques[i] = new TaskDeque;
+
+    // Workers are started once all deques exist, since they steal from each other.
+    for (int i = 0; i < threadCount; i++)
+    {
+        Workers.PushBack(*new TaskWorker(this, i));
+        Workers[i]->Start();
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    OVR_ASSERT(!hasQueuedTasks());
+
+    if (Workers.GetSize())
+    {
+        {
+            Mutex::Locker lock(&WakeMutex);
+            Exiting = true;
+            WakeCondition.NotifyAll();
+        }
+        WorkersExited.Wait();
+    }
+    Workers.Clear();
+
+    for (UPInt i = 0; i < Deques.GetSize(); i++)
+        delete Deques[i];
+}
+
+int TaskScheduler::getWorkerIndex() const
+{
+    const int* number = WorkerNumber.TryGet();
+    return number ? (*number - 1) : -1;
+}
+
+#ifdef OVR_BUILD_DEBUG
+Task* TaskScheduler::getCurrentTask(int worker) const
+{
+    return (worker >= 0) ? Deques[worker]->pCurrent : 0;
+}
+#endif
+
+bool TaskScheduler::isHelping() const
+{
+    const bool* helping = Helping.TryGet();
+    return helping && *helping;
+}
+
+bool TaskScheduler::hasQueuedTasks() const
+{
+    if (SharedCount)
+        return true;
+    for (UPInt i = 0; i < Deques.GetSize(); i++)
+    {
+        if (!Deques[i]->IsEmpty())
+            return true;
+    }
+    return false;
+}
+
+void TaskScheduler::push(Task* task)
+{
+    int  worker = getWorkerIndex();
+    bool queued = true;
+
+    if (worker >= 0)
+    {
+        // A full deque just means there is plenty of parallel work; run the task
+        // right away instead.
+        queued = Deques[worker]->Push(task);
+    }
+    else
+    {
+        // Without worker threads, these run when the group is waited on. Tasks
+        // run while helping in a wait would have to be waited on in a nested one,
+        // which can't help without unbounded recursion; they run right away.
+        if ((queued = !isHelping()) == true)
+        {
+            Lock::Locker lock(&SharedLock);
+            SharedTasks.PushBack(task);
+            SharedCount.ExchangeAdd_Sync(1);
+        }
+    }
+
+    if (!queued)
+    {
+        execute(worker, task);
+        return;
+    }
+
+    if (SleepingWorkers)
+        wakeWorker();
+}
+
+void TaskScheduler::wakeWorker()
+{
+    Mutex::Locker lock(&WakeMutex);
+    WakeCondition.Notify();
+}
+
+Task* TaskScheduler::findTask(int worker, bool steal)
+{
+    Task* task;
+
+    if ((worker >= 0) && (task = Deques[worker]->Pop()) != 0)
+        return task;
+
+    if (!steal && (worker >= 0))
+        return 0;
+
+    if (SharedCount)
+    {
+        Lock::Locker lock(&SharedLock);
+        if (SharedHead < SharedTasks.GetSize())
+        {
+            task = SharedTasks[SharedHead++];
+            if (SharedHead == SharedTasks.GetSize())
+            {
+                SharedTasks.Clear();
+                SharedHead = 0;
+            }
+            SharedCount.ExchangeAdd_NoSync(-1);
+            return task;
+        }
+    }
+
+    if (!steal)
+        return 0;
+
+    // Steal, starting past our own deque so that thieves spread out.
+    int count = (int)Deques.GetSize();
+    for (int i = 1; i <= count; i++)
+    {
+        int victim = (worker + i) % count;
+        if ((task = Deques[victim]->Steal()) != 0)
+            return task;
+    }
+    return 0;
+}
+
+void TaskScheduler::execute(int worker, Task* task)
+{
+    TaskGroup* group = task->pGroup;
+
+    if (worker >= 0)
+    {
+        TaskDeque* deque = Deques[worker];
+        UPInt      base  = deque->TaskBase;
+        deque->TaskBase  = deque->GetBottom();
+#ifdef OVR_BUILD_DEBUG
+        Task* current    = deque->pCurrent;
+        deque->pCurrent  = task;
+#endif
+        task->Execute();
+        deque->TaskBase  = base;
+#ifdef OVR_BUILD_DEBUG
+        deque->pCurrent  = current;
+#endif
+    }
+    else
+    {
+        task->Execute();
+    }
+    group->finishTask();
+}
+
+bool TaskScheduler::runOneTask(int worker, bool steal)
+{
+    Task* task = findTask(worker, steal);
+    if (!task)
+        return false;
+    execute(worker, task);
+    return true;
+}
+
+void TaskScheduler::workerRun(int worker)
+{
+    WorkerNumber.Get() = worker + 1;
+
+    unsigned idle = 0;
+    while (!Exiting)
+    {
+        if (runOneTask(worker, true))
+        {
+            idle = 0;
+            continue;
+        }
+        if (++idle < IdleSpinCount)
+        {
+            spinPause();
+            continue;
+        }
+
+        Mutex::Locker lock(&WakeMutex);
+        // Announce before the final check; a pusher that misses the new count
+        // published its task before it looked, so the check below sees it.
+        SleepingWorkers.ExchangeAdd_Sync(1);
+        if (!Exiting && !hasQueuedTasks())
+            WakeCondition.Wait(&WakeMutex);
+        SleepingWorkers.ExchangeAdd_Sync(-1);
+        idle = 0;
+    }
+
+    // The scheduler may be destroyed as soon as the last worker signals, before
+    // this thread has exited.
+    WorkerNumber.Release();
+    if (RunningWorkers.ExchangeAdd_Sync(-1) == 1)
+        WorkersExited.Signal();
+}
+
+} // OVR
+
+#endif // OVR_ENABLE_THREADS
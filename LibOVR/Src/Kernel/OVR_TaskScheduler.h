@@ -0,0 +1,280 @@
+/************************************************************************************
+
+PublicHeader:   None
+Filename    :   OVR_TaskScheduler.h
+Content     :   Work-stealing task scheduler, task groups and ParallelFor
+Created     :   October 19, 2026
+Notes       :
+
+Copyright   :   Copyright 2013 Oculus VR, Inc. All Rights reserved.
+
+Use of this software is subject to the terms of the Oculus license
+agreement provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+************************************************************************************/
+
+#ifndef OVR_TaskScheduler_h
+#define OVR_TaskScheduler_h
+
+#include "OVR_Threads.h"
+#include "OVR_Alg.h"
+
+#ifdef OVR_ENABLE_THREADS
+
+namespace OVR {
+
+class Task;
+class TaskGroup;
+class TaskScheduler;
+class TaskWorker;
+class TaskDeque;
+
+
+//-----------------------------------------------------------------------------------
+// ***** Task
+
+// Task is a unit of work run by TaskScheduler. Tasks are owned by the caller, are
+// never copied, and must stay alive until the TaskGroup they were run in has been
+// waited on.
+
+class Task
+{
+    friend class TaskGroup;
+    friend class TaskScheduler;
+
+    TaskGroup*  pGroup;
+
+public:
+    Task() : pGroup(0) { }
+    virtual ~Task() { }
+
+    virtual void Execute() = 0;
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** TaskGroup
+
+// TaskGroup tracks a set of tasks so that one thread can wait for all of them.
+// Tasks may run further tasks in the same or in other groups, and may wait on
+// groups themselves. A waiting thread executes queued tasks until its group is
+// done, so nested waits don't tie up workers.
+//
+// A group must be waited on by the task, or the thread outside the pool, that ran
+// its tasks; tasks of the group may add more to it. A worker only pops tasks that
+// were pushed since its current task started, so a group run by one task and
+// waited on by another may never see its tasks executed.
+
+class TaskGroup
+{
+    friend class TaskScheduler;
+
+    enum { WaiterSleeping = 1, TaskCountOne = 2 };
+
+    TaskScheduler*      pScheduler;
+    // Count of unfinished tasks times TaskCountOne, plus WaiterSleeping while the
+    // waiting thread is blocked on pWaitEvent.
+    AtomicInt<UPInt>    State;
+    CompletionEvent*    pWaitEvent;
+#ifdef OVR_BUILD_DEBUG
+    // Task that ran the group's tasks, on worker OwnerWorker; checked by Wait.
+    bool                HasOwner;
+    int                 OwnerWorker;
+    Task*               pOwnerTask;
+#endif
+
+    // Called after each task of the group has executed.
+    void    finishTask();
+
+public:
+    TaskGroup(TaskScheduler* scheduler)
+        : pScheduler(scheduler), State(0), pWaitEvent(0)
+    {
+#ifdef OVR_BUILD_DEBUG
+        HasOwner = false;
+#endif
+    }
+    ~TaskGroup()
+    { OVR_ASSERT(IsDone()); }
+
+    // Queues task for execution by the scheduler.
+    void    Run(Task* task);
+    // Returns once every task run in this group has finished. Only one thread
+    // may wait on a group at a time.
+    void    Wait();
+
+    bool    IsDone() const  { return State.Load_Acquire() < TaskCountOne; }
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** TaskScheduler
+
+// TaskScheduler runs tasks on a pool of worker threads. Each worker has its own
+// deque: tasks run by a worker are pushed to and popped from the bottom of its
+// deque, and idle workers steal from the top of the others'. Tasks run from other
+// threads go to a shared queue. Workers sleep when no work can be found.
+//
+// The worker count includes the thread that waits on a group, since it executes
+// tasks while waiting; WorkerCount - 1 threads are created. The default is
+// Thread::GetCPUCount().
+//
+// To keep nested waits from growing the stack without bound, a waiting worker
+// only pops tasks pushed since its current task started, and stops stealing once
+// its waits nest deeply. Threads outside the pool help in their outermost wait
+// only; tasks they run from within a task executed that way run immediately.
+
+class TaskScheduler : public NewOverrideBase
+{
+    friend class TaskGroup;
+    friend class TaskWorker;
+
+public:
+    TaskScheduler(int workerCount = 0);
+    // Waits for the worker threads to finish. No tasks may be queued.
+    ~TaskScheduler();
+
+    int     GetWorkerCount() const  { return WorkerCount; }
+
+private:
+    // Queues the task, on the calling worker's deque if there is one.
+    void    push(Task* task);
+    // Executes one queued task, if any can be found; returns 'false' otherwise.
+    // Without 'steal', workers only take tasks from their own deque.
+    bool    runOneTask(int worker, bool steal);
+    void    execute(int worker, Task* task);
+    Task*   findTask(int worker, bool steal);
+
+    // Index of the calling thread's deque, or -1 for threads outside the pool.
+    int     getWorkerIndex() const;
+#ifdef OVR_BUILD_DEBUG
+    // Task executing on 'worker', or 0 for threads outside the pool.
+    Task*   getCurrentTask(int worker) const;
+#endif
+    // Whether the calling thread, from outside the pool, is running tasks from
+    // within a wait.
+    bool    isHelping() const;
+    bool    hasQueuedTasks() const;
+    void    wakeWorker();
+    // Main loop of worker thread 'worker'.
+    void    workerRun(int worker);
+
+    int                 WorkerCount;
+    // One per worker thread.
+    ArrayPOD<TaskDeque*> Deques;
+    Array<Ptr<TaskWorker> > Workers;
+    // Worker index plus one; zero for threads outside the pool.
+    ThreadLocal<int>    WorkerNumber;
+    ThreadLocal<bool>   Helping;
+
+    // Tasks run from outside the pool, in FIFO order.
+    Lock                SharedLock;
+    ArrayPOD<Task*>     SharedTasks;
+    UPInt               SharedHead;
+    AtomicInt<int>      SharedCount;
+
+    // Idle workers sleep on WakeCondition.
+    Mutex               WakeMutex;
+    WaitCondition       WakeCondition;
+    AtomicInt<int>      SleepingWorkers;
+    volatile bool       Exiting;
+    AtomicInt<int>      RunningWorkers;
+    CompletionEvent     WorkersExited;
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** ParallelFor
+
+// Task used by ParallelForRange; a set of them hand out chunks of the range from a
+// shared counter, so a chunk is only taken when a thread is free to run it.
+template<class F>
+class ParallelForTask : public Task
+{
+public:
+    F*                  pBody;
+    UPInt               Begin, End, GrainSize;
+    AtomicInt<UPInt>*   pNextChunk;
+
+    virtual void Execute()
+    {
+        UPInt chunkCount = (End - Begin + GrainSize - 1) / GrainSize;
+        UPInt chunk;
+        while ((chunk = pNextChunk->ExchangeAdd_NoSync(1)) < chunkCount)
+        {
+            UPInt begin = Begin + chunk * GrainSize;
+            UPInt end   = (End - begin > GrainSize) ? begin + GrainSize : End;
+            (*pBody)(begin, end);
+        }
+    }
+};
+
+// Calls body(begin, end) on sub-ranges of [begin, end) in parallel, and returns
+// once all have completed. Each sub-range holds up to grainSize indices; 0 picks a
+// size that gives each worker about eight sub-ranges.
+template<class F>
+void ParallelForRange(TaskScheduler* scheduler, UPInt begin, UPInt end, F& body,
+                      UPInt grainSize = 0)
+{
+    if (end <= begin)
+        return;
+
+    UPInt workers = (UPInt)scheduler->GetWorkerCount();
+    if (grainSize == 0)
+        grainSize = Alg::Max<UPInt>((end - begin) / (workers * 8), 1);
+
+    UPInt chunkCount = (end - begin + grainSize - 1) / grainSize;
+    UPInt taskCount  = Alg::Min(workers, chunkCount);
+
+    AtomicInt<UPInt>            nextChunk(0);
+    Array<ParallelForTask<F> >  tasks;
+    tasks.Resize(taskCount);
+
+    TaskGroup group(scheduler);
+    for (UPInt i = 0; i < taskCount; i++)
+    {
+        ParallelForTask<F>& t = tasks[i];
+        t.pBody      = &body;
+        t.Begin      = begin;
+        t.End        = end;
+        t.GrainSize  = grainSize;
+        t.pNextChunk = &nextChunk;
+        // The calling thread takes the first share itself.
+        if (i > 0)
+            group.Run(&t);
+    }
+    tasks[0].Execute();
+    group.Wait();
+}
+
+// Body adapter used by ParallelFor.
+template<class A, class F>
+struct ParallelForElements
+{
+    A*  pArray;
+    F*  pBody;
+
+    void operator()(UPInt begin, UPInt end)
+    {
+        for (UPInt i = begin; i < end; i++)
+            (*pBody)((*pArray)[i]);
+    }
+};
+
+// Calls body(array[i]) for every element of array in parallel, which may be any
+// Array type, and returns once all calls have completed.
+template<class A, class F>
+void ParallelFor(TaskScheduler* scheduler, A& array, F& body, UPInt grainSize = 0)
+{
+    ParallelForElements<A, F> elements;
+    elements.pArray = &array;
+    elements.pBody  = &body;
+    ParallelForRange(scheduler, 0, array.GetSize(), elements, grainSize);
+}
+
+} // OVR
+
+#endif // OVR_ENABLE_THREADS
+
+#endif // OVR_TaskScheduler_h
@@ -20,6 +20,7 @@ otherwise accompanies this software in either electronic or hard copy form.
 #include "OVR_Atomic.h"
 #include "OVR_RefCount.h"
 #include "OVR_Array.h"
+#include "OVR_List.h"
 
 // Defines the infinite wait delay timeout
 #define OVR_WAIT_INFINITE 0xFFFFFFFF
@@ -37,6 +38,10 @@ namespace OVR {
 class   Mutex;
 class   WaitCondition;
 class   Event;
+class   CompletionEvent;
+class   ThreadLocalBase;
+template<class T> class ThreadLocal;
+class   ShardedCounter;
 // Implementation forward declarations
 class MutexImpl;
 class WaitConditionImpl;
@@ -161,6 +166,217 @@ public:
 };
 
 
+//-----------------------------------------------------------------------------------
+// ***** CompletionEvent
+
+// CompletionEvent is a one-shot event that one thread waits on until another thread
+// signals it, such as the completion of a synchronous call. Unlike Event it needs no
+// heap allocation and can be placed in the waiter's stack frame: once Wait returns,
+// the signaling thread no longer touches it. On Linux the event is a single futex
+// word; other platforms put the waiter to sleep on a system event or condition.
+
+class CompletionEvent
+{
+    // Not signaled, not signaled with a sleeping waiter, or signaled.
+    enum { State_Clear, State_Sleeping, State_Signaled };
+
+    AtomicInt<int>      State;
+#if defined(OVR_OS_WIN32)
+    HANDLE              hEvent;     // Created only if the waiter has to sleep.
+#elif !defined(OVR_OS_LINUX)
+    pthread_mutex_t     SleepMutex;
+    pthread_cond_t      SleepCondition;
+    volatile bool       Signaled;
+#endif
+
+public:
+    CompletionEvent();
+    ~CompletionEvent();
+
+    bool    IsSignaled() const  { return State.Load_Acquire() == State_Signaled; }
+
+    // Releases the waiter. Must be called exactly once.
+    void    Signal();
+    // Waits until Signal is called. Polls up to spinCount times first, which avoids
+    // sleeping when the signal is expected within a few microseconds.
+    void    Wait(unsigned spinCount = 0);
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** ThreadLocal
+
+// ThreadLocalBase keeps track of the per-thread values of a ThreadLocal, so that they
+// can be visited from any thread and destroyed when their thread exits or when the
+// ThreadLocal is destroyed. Values are found through a pthread key, or a Win32 fiber
+// local storage index where FlsAlloc is available; without it, on Windows XP, values
+// of exited threads are only destroyed with the ThreadLocal.
+
+class ThreadLocalBase : public NewOverrideBase
+{
+protected:
+    struct Slot : public ListNode<Slot>, public NewOverrideBase
+    {
+        ThreadLocalBase* pOwner;
+    };
+
+    ThreadLocalBase();
+    ~ThreadLocalBase();
+
+    // Slot of the calling thread, or 0 if it has none yet.
+#if defined(OVR_OS_WIN32)
+    Slot*   getSlot() const;
+#else
+    Slot*   getSlot() const     { return (Slot*)pthread_getspecific(Key); }
+#endif
+    // Makes slot the calling thread's slot.
+    void    addSlot(Slot* slot);
+    // Destroys the calling thread's slot, if it has one.
+    void    removeSlot();
+    // Destroys the slots of all threads; must be called by the derived destructor.
+    void    destroySlots();
+    // Destroys a slot; called with SlotLock held.
+    virtual void destroySlot(Slot* slot, bool threadExit) = 0;
+
+    Lock        SlotLock;
+    List<Slot>  Slots;
+
+private:
+    static void OVR_STDCALL onThreadExit(void* slot);
+
+    bool        Destroying;
+#if defined(OVR_OS_WIN32)
+    DWORD       Index;
+    bool        UseFls;
+#else
+    pthread_key_t Key;
+#endif
+};
+
+
+// ThreadLocal holds a separate value of T for each thread that calls Get. A value is
+// value-initialized on the first Get call of its thread, and destroyed when the thread
+// exits or the ThreadLocal is destroyed, whichever comes first. A ThreadLocal must not
+// be destroyed while threads that used it may still be exiting.
+
+template<class T>
+class ThreadLocal : public ThreadLocalBase
+{
+    struct ValueSlot : public Slot
+    {
+        T   Value;
+        ValueSlot() : Value() { }
+    };
+
+public:
+    ThreadLocal() { }
+    ~ThreadLocal()          { destroySlots(); }
+
+    // Returns the calling thread's value, creating it if needed.
+    T&      Get()
+    {
+        Slot* slot = getSlot();
+        if (!slot)
+        {
+            slot = new ValueSlot;
+            addSlot(slot);
+        }
+        return ((ValueSlot*)slot)->Value;
+    }
+    // Returns the calling thread's value, or 0 if it hasn't created one.
+    T*      TryGet() const
+    {
+        Slot* slot = getSlot();
+        return slot ? &((ValueSlot*)slot)->Value : 0;
+    }
+    // Destroys the calling thread's value now, without calling onThreadExit; a thread
+    // that has done so may outlive the ThreadLocal.
+    void    Release()       { removeSlot(); }
+
+    // Calls visitor(T&) for the value of every thread that has one. Values are not
+    // created or destroyed during the call, but their threads may be using them.
+    template<class F>
+    void    ForEach(F& visitor)
+    {
+        Lock::Locker lock(&SlotLock);
+        for (Slot* slot = Slots.GetFirst(); !Slots.IsNull(slot); slot = Slots.GetNext(slot))
+            visitor(((ValueSlot*)slot)->Value);
+    }
+
+protected:
+    // Called with a thread's value as the thread exits, before the value is destroyed;
+    // no ForEach call is in progress.
+    virtual void onThreadExit(T& value)     { OVR_UNUSED(value); }
+
+private:
+    virtual void destroySlot(Slot* slot, bool threadExit)
+    {
+        if (threadExit)
+            onThreadExit(((ValueSlot*)slot)->Value);
+        delete (ValueSlot*)slot;
+    }
+};
+
+
+//-----------------------------------------------------------------------------------
+// ***** ShardedCounter
+
+// ShardedCounter is a counter that many threads can update without contending for a
+// cache line: each thread adds to its own shard, and GetValue sums the shards. Counts
+// of exited threads are kept. Intended for statistics; on CPUs without 8-byte atomic
+// operations, GetValue may see a shard halfway through an update.
+
+struct ShardedCounterShard
+{
+    AtomicInt<SInt64>   Value;
+    // Keeps the shards of different threads out of each other's cache line.
+    UByte               Pad[64];
+
+    ShardedCounterShard() : Value(0) { }
+};
+
+class ShardedCounter : public NewOverrideBase
+{
+    // Adds the shards of exited threads to Retired.
+    class Shards : public ThreadLocal<ShardedCounterShard>
+    {
+        virtual void onThreadExit(ShardedCounterShard& shard)  { Retired += shard.Value; }
+    public:
+        SInt64  Retired;
+
+        Shards() : Retired(0) { }
+        Lock*   GetLock()   { return &SlotLock; }
+    };
+
+    struct Sum
+    {
+        SInt64 Total;
+        void operator()(ShardedCounterShard& shard) { Total += shard.Value; }
+    };
+
+    Shards  PerThread;
+
+public:
+    // Only the calling thread writes its shard, so no read-modify-write is needed.
+    void    Add(SInt64 delta)
+    {
+        AtomicInt<SInt64>& value = PerThread.Get().Value;
+        value.Store_Release(value + delta);
+    }
+    void    Increment()     { Add(1); }
+
+    SInt64  GetValue()
+    {
+        // Retired is updated under the same lock as ForEach takes.
+        Lock::Locker lock(PerThread.GetLock());
+        Sum sum;
+        sum.Total = PerThread.Retired;
+        PerThread.ForEach(sum);
+        return sum.Total;
+    }
+};
+
+
 //-----------------------------------------------------------------------------------
 // ***** Thread class
 
@@ -6,6 +6,7 @@
 
 #include "OVR_Timer.h"
 #include "OVR_Log.h"
+#include "OVR_Alg.h"
 
 #include <pthread.h>
 #include <time.h>
@@ -23,6 +24,12 @@ using std::timespec;
 #include <errno.h>
 #endif
 
+#ifdef OVR_OS_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <limits.h>
+#endif
+
 namespace OVR {
 
 // ***** Mutex implementation
@@ -207,6 +214,227 @@ void Event::updateState(bool newState, bool newTemp, bool mustNotify)
 
 
 
+//-----------------------------------------------------------------------------------
+// ***** CompletionEvent
+
+static inline void spinPause()
+{
+#if defined(OVR_CPU_X86) || defined(OVR_CPU_X86_64)
+    asm volatile("pause\n" ::: "memory");
+#endif
+}
+
+#ifdef OVR_OS_LINUX
+
+static inline void futexWait(volatile int* p, int value)
+{
+    syscall(SYS_futex, p, FUTEX_WAIT_PRIVATE, value, (void*)0, (void*)0, 0);
+}
+
+static inline void futexWake(volatile int* p)
+{
+    syscall(SYS_futex, p, FUTEX_WAKE_PRIVATE, INT_MAX, (void*)0, (void*)0, 0);
+}
+
+CompletionEvent::CompletionEvent()
+    : State(State_Clear)
+{
+}
+
+CompletionEvent::~CompletionEvent()
+{
+}
+
+void CompletionEvent::Signal()
+{
+    // Only wake if the waiter announced that it is going to sleep. The wake call
+    // uses the address only as a key, so it is harmless if the waiter has already
+    // seen the new state and returned.
+    if (State.Exchange_Sync(State_Signaled) == State_Sleeping)
+        futexWake(&State.Value);
+}
+
+void CompletionEvent::Wait(unsigned spinCount)
+{
+    for (unsigned i = 0; i < spinCount; i++)
+    {
+        if (IsSignaled())
+            return;
+        spinPause();
+    }
+
+    if (!State.CompareAndSet_Sync(State_Clear, State_Sleeping) && IsSignaled())
+        return;
+
+    while (!IsSignaled())
+        futexWait(&State.Value, State_Sleeping);
+}
+
+#else // OVR_OS_LINUX
+
+CompletionEvent::CompletionEvent()
+    : State(State_Clear), Signaled(false)
+{
+    pthread_mutex_init(&SleepMutex, 0);
+    pthread_cond_init(&SleepCondition, 0);
+}
+
+CompletionEvent::~CompletionEvent()
+{
+    pthread_cond_destroy(&SleepCondition);
+    pthread_mutex_destroy(&SleepMutex);
+}
+
+void CompletionEvent::Signal()
+{
+    if (State.Exchange_Sync(State_Signaled) == State_Sleeping)
+    {
+        pthread_mutex_lock(&SleepMutex);
+        Signaled = true;
+        pthread_cond_signal(&SleepCondition);
+        pthread_mutex_unlock(&SleepMutex);
+    }
+}
+
+void CompletionEvent::Wait(unsigned spinCount)
+{
+    for (unsigned i = 0; i < spinCount; i++)
+    {
+        if (IsSignaled())
+            return;
+        spinPause();
+    }
+
+    if (!State.CompareAndSet_Sync(State_Clear, State_Sleeping))
+        return;
+
+    // The signaling thread holds SleepMutex for as long as it uses this object,
+    // so returning after re-acquiring it is safe.
+    pthread_mutex_lock(&SleepMutex);
+    while (!Signaled)
+        pthread_cond_wait(&SleepCondition, &SleepMutex);
+    pthread_mutex_unlock(&SleepMutex);
+}
+
+#endif // OVR_OS_LINUX
+
+
+//-----------------------------------------------------------------------------------
+// ***** Lock
+
+// Pauses between trylock attempts double after each failure, up to this many.
+static const unsigned LockMaxBackoff = 64;
+static volatile int   LockCPUCount   = 0;
+
+void Lock::lockContended()
+{
+    bool     stats  = StatsEnabled;
+    UInt64   start  = stats ? Timer::GetProfileTicks() : 0;
+    unsigned spins  = 0;
+    bool     locked = false;
+
+    if (LockCPUCount == 0)
+        LockCPUCount = Thread::GetCPUCount();
+
+    // The holder can't make progress while we spin on a single CPU.
+    if (SpinCount && (LockCPUCount > 1))
+    {
+        // Spin up to about twice as long as recent acquisitions needed, as adaptive
+        // pthread mutexes do, so that a lock that is held for long stops spinning.
+        unsigned limit   = Alg::Min(SpinCount, SpinEstimate * 2 + 16);
+        unsigned backoff = 1;
+
+        while (spins < limit)
+        {
+            for (unsigned i = 0; i < backoff; i++)
+                spinPause();
+            spins += backoff;
+            if (pthread_mutex_trylock(&mutex) == 0)
+            {
+                locked = true;
+                break;
+            }
+            if (backoff < LockMaxBackoff)
+                backoff *= 2;
+        }
+    }
+
+    if (!locked)
+        pthread_mutex_lock(&mutex);
+
+    // Only the owner modifies these. A spin that failed counts as zero, so the
+    // estimate decays while the lock is held for longer than the limit.
+    int target   = locked ? (int)spins : 0;
+    SpinEstimate = (unsigned)((int)SpinEstimate + (target - (int)SpinEstimate) / 8);
+    if (stats && StatsEnabled)
+    {
+        Stats.Acquisitions++;
+        Stats.ContendedAcquisitions++;
+        Stats.WaitTicks += Timer::GetProfileTicks() - start;
+    }
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** ThreadLocal
+
+ThreadLocalBase::ThreadLocalBase()
+    : Destroying(false)
+{
+    pthread_key_create(&Key, onThreadExit);
+}
+
+ThreadLocalBase::~ThreadLocalBase()
+{
+    OVR_ASSERT(Destroying);
+}
+
+void ThreadLocalBase::addSlot(Slot* slot)
+{
+    slot->pOwner = this;
+    {
+        Lock::Locker lock(&SlotLock);
+        Slots.PushBack(slot);
+    }
+    pthread_setspecific(Key, slot);
+}
+
+void ThreadLocalBase::removeSlot()
+{
+    Slot* slot = getSlot();
+    if (!slot)
+        return;
+    pthread_setspecific(Key, 0);
+    Lock::Locker lock(&SlotLock);
+    Slots.Remove(slot);
+    destroySlot(slot, false);
+}
+
+void ThreadLocalBase::destroySlots()
+{
+    Lock::Locker lock(&SlotLock);
+    Destroying = true;
+    // Deleting the key doesn't call onThreadExit for the remaining slots.
+    pthread_key_delete(Key);
+    while (!Slots.IsEmpty())
+    {
+        Slot* slot = Slots.GetFirst();
+        Slots.Remove(slot);
+        destroySlot(slot, false);
+    }
+}
+
+void OVR_STDCALL ThreadLocalBase::onThreadExit(void* p)
+{
+    Slot*            slot  = (Slot*)p;
+    ThreadLocalBase* owner = slot->pOwner;
+
+    Lock::Locker lock(&owner->SlotLock);
+    owner->Slots.Remove(slot);
+    owner->destroySlot(slot, true);
+}
+
+
 // ***** Wait Condition Implementation
 
 // Internal implementation class
@@ -780,7 +1008,12 @@ bool    Thread::MSleep(unsigned msecs)
 /* static */
 int     Thread::GetCPUCount()
 {
+#if defined(_SC_NPROCESSORS_ONLN)
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+#else
     return 1;
+#endif
 }
 
 
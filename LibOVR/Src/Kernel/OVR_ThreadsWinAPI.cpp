@@ -187,6 +187,147 @@ void Event::updateState(bool newState, bool newTemp, bool mustNotify)
 }
 
 
+//-----------------------------------------------------------------------------------
+// ***** CompletionEvent
+
+CompletionEvent::CompletionEvent()
+    : State(State_Clear), hEvent(0)
+{
+}
+
+CompletionEvent::~CompletionEvent()
+{
+    if (hEvent)
+        ::CloseHandle(hEvent);
+}
+
+void CompletionEvent::Signal()
+{
+    // hEvent is published by the waiter's compare-and-set before State_Sleeping.
+    if (State.Exchange_Sync(State_Signaled) == State_Sleeping)
+        ::SetEvent(hEvent);
+}
+
+void CompletionEvent::Wait(unsigned spinCount)
+{
+    for (unsigned i = 0; i < spinCount; i++)
+    {
+        if (IsSignaled())
+            return;
+        YieldProcessor();
+    }
+
+    // The kernel event is only created when we actually have to sleep.
+    hEvent = ::CreateEvent(0, FALSE, FALSE, 0);
+    if (!State.CompareAndSet_Sync(State_Clear, State_Sleeping))
+        return;
+
+    ::WaitForSingleObject(hEvent, INFINITE);
+}
+
+
+//-----------------------------------------------------------------------------------
+// ***** ThreadLocal
+
+// Fiber local storage calls back when a thread exits, unlike TLS, but is missing on
+// Windows XP; load it dynamically so that we don't require Vista.
+typedef VOID  (WINAPI *Function_FlsCallback)(PVOID);
+typedef DWORD (WINAPI *Function_FlsAlloc)(Function_FlsCallback);
+typedef PVOID (WINAPI *Function_FlsGetValue)(DWORD);
+typedef BOOL  (WINAPI *Function_FlsSetValue)(DWORD, PVOID);
+typedef BOOL  (WINAPI *Function_FlsFree)(DWORD);
+
+static bool                 FlsInitTried = 0;
+static Function_FlsAlloc    pFlsAlloc    = 0;
+static Function_FlsGetValue pFlsGetValue = 0;
+static Function_FlsSetValue pFlsSetValue = 0;
+static Function_FlsFree     pFlsFree     = 0;
+
+ThreadLocalBase::ThreadLocalBase()
+    : Destroying(false)
+{
+    if (!FlsInitTried)
+    {
+        HMODULE hmodule = ::LoadLibrary(OVR_STR("kernel32.dll"));
+        pFlsGetValue = (Function_FlsGetValue)::GetProcAddress(hmodule, "FlsGetValue");
+        pFlsSetValue = (Function_FlsSetValue)::GetProcAddress(hmodule, "FlsSetValue");
+        pFlsFree     = (Function_FlsFree)::GetProcAddress(hmodule, "FlsFree");
+        // Set last, since it decides whether the others are used.
+        pFlsAlloc    = (Function_FlsAlloc)::GetProcAddress(hmodule, "FlsAlloc");
+        FlsInitTried = true;
+    }
+
+    UseFls = (pFlsAlloc != 0);
+    Index  = UseFls ? pFlsAlloc(onThreadExit) : ::TlsAlloc();
+}
+
+ThreadLocalBase::~ThreadLocalBase()
+{
+    OVR_ASSERT(Destroying);
+}
+
+ThreadLocalBase::Slot* ThreadLocalBase::getSlot() const
+{
+    return (Slot*)(UseFls ? pFlsGetValue(Index) : ::TlsGetValue(Index));
+}
+
+void ThreadLocalBase::addSlot(Slot* slot)
+{
+    slot->pOwner = this;
+    {
+        Lock::Locker lock(&SlotLock);
+        Slots.PushBack(slot);
+    }
+    if (UseFls)
+        pFlsSetValue(Index, slot);
+    else
+        ::TlsSetValue(Index, slot);
+}
+
+void ThreadLocalBase::removeSlot()
+{
+    Slot* slot = getSlot();
+    if (!slot)
+        return;
+    if (UseFls)
+        pFlsSetValue(Index, 0);
+    else
+        ::TlsSetValue(Index, 0);
+    Lock::Locker lock(&SlotLock);
+    Slots.Remove(slot);
+    destroySlot(slot, false);
+}
+
+void ThreadLocalBase::destroySlots()
+{
+    Lock::Locker lock(&SlotLock);
+    Destroying = true;
+    // FlsFree calls onThreadExit for the remaining slots, which leaves them to us.
+    if (UseFls)
+        pFlsFree(Index);
+    else
+        ::TlsFree(Index);
+    while (!Slots.IsEmpty())
+    {
+        Slot* slot = Slots.GetFirst();
+        Slots.Remove(slot);
+        destroySlot(slot, false);
+    }
+}
+
+void OVR_STDCALL ThreadLocalBase::onThreadExit(void* p)
+{
+    Slot*            slot  = (Slot*)p;
+    ThreadLocalBase* owner = slot->pOwner;
+
+    Lock::Locker lock(&owner->SlotLock);
+    if (owner->Destroying)
+        return;
+    owner->Slots.Remove(slot);
+    owner->destroySlot(slot, true);
+}
+
+
 //-----------------------------------------------------------------------------------
 // ***** Win32 Wait Condition Implementation
 
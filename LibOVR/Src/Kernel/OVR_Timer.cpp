@@ -22,6 +22,14 @@ otherwise accompanies this software in either electronic or hard copy form.
 #include <sys/time.h>
 #endif
 
+#if defined(OVR_CPU_X86) || defined(OVR_CPU_X86_64)
+#if defined(OVR_CC_MSVC)
+#include <intrin.h>
+#elif defined(OVR_CC_GNU)
+#include <x86intrin.h>
+#endif
+#endif
+
 namespace OVR {
 
 //-----------------------------------------------------------------------------------
@@ -37,6 +45,15 @@ double Timer::GetProfileSeconds()
     return TicksToSeconds(GetProfileTicks()-StartTime);
 }
 
+UInt64 Timer::GetCycleCount()
+{
+#if (defined(OVR_CPU_X86) || defined(OVR_CPU_X86_64)) && (defined(OVR_CC_MSVC) || defined(OVR_CC_GNU))
+    return __rdtsc();
+#else
+    return GetRawTicks();
+#endif
+}
+
 
 //------------------------------------------------------------------------
 // *** Win32 Specific Timer
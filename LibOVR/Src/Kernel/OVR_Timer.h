@@ -73,6 +73,11 @@ public:
     static UInt64  OVR_STDCALL GetRawTicks();
     static UInt64  OVR_STDCALL GetRawFrequency();
 
+    // Returns the CPU time stamp counter where it can be read with a single instruction
+    // (x86), or GetRawTicks() elsewhere. Meant for timing very short code spans; the
+    // unit is unspecified and values should only be compared on the same thread.
+    static UInt64  OVR_STDCALL GetCycleCount();
+
     
     // ***** Tick and time unit conversion.
 
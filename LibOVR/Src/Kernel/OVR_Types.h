@@ -141,6 +141,12 @@ otherwise accompanies this software in either electronic or hard copy form.
 #  error "Oculus does not support this Compiler"
 #endif
 
+// OVR_CPP11 is defined when the compiler supports the C++11 language features
+// (variadic templates, rvalue references, lambdas) used by optional LibOVR APIs.
+#if (__cplusplus >= 201103L) || (defined(OVR_CC_MSVC) && (OVR_CC_MSVC >= 1800))
+#  define OVR_CPP11
+#endif
+
 
 //-----------------------------------------------------------------------------------
 // ***** Compiler Warnings
@@ -50,7 +50,7 @@ Lock* SharedLock::GetLockAddRef()
             // Initialize marker
             if (AtomicOps<int>::CompareAndSet_Sync(&UseCount, 0, LockInitMarker))
             {
-                Construct<Lock>(Buffer);
+                ConstructAlt<Lock>(Buffer, (unsigned)Lock::ShortSectionSpinCount);
                 do { }
                 while (!AtomicOps<int>::CompareAndSet_Sync(&UseCount, LockInitMarker, 1));
                 return toLock();
@@ -58,7 +58,7 @@ Lock* SharedLock::GetLockAddRef()
             continue;
         }
 
-    } while (!AtomicOps<int>::CompareAndSet_NoSync(&UseCount, oldUseCount, oldUseCount + 1));
+    } while (!AtomicOps<int>::CompareAndSet_Acquire(&UseCount, oldUseCount, oldUseCount + 1));
 
     return toLock();
 }
@@ -89,7 +89,7 @@ void SharedLock::ReleaseLock(Lock* plock)
             continue;
         }
 
-    } while (!AtomicOps<int>::CompareAndSet_NoSync(&UseCount, oldUseCount, oldUseCount - 1));
+    } while (!AtomicOps<int>::CompareAndSet_Release(&UseCount, oldUseCount, oldUseCount - 1));
 }
 
 
@@ -414,14 +414,14 @@ Void DeviceManagerImpl::ReleaseDevice_MgrThread(DeviceBase* device)
 
         if (refCount > 1)
         {
-            if (devCommon->RefCount.CompareAndSet_NoSync(refCount, refCount-1))
+            if (devCommon->RefCount.CompareAndSet_Release(refCount, refCount-1))
             {
                 // We decreented from initial count higher then 1;
                 // nothing else to do.
                 return 0;
             }        
         }
-        else if (devCommon->RefCount.CompareAndSet_NoSync(1, 0))
+        else if (devCommon->RefCount.CompareAndSet_Sync(1, 0))
         {
             // { 1 -> 0 } decrement succeded. Destroy this device.
             break;
@@ -667,7 +667,7 @@ void DeviceCommon::DeviceRelease()
             // Warning! At his point everything, including manager, may be dead.
             break;
         }
-        else if (RefCount.CompareAndSet_NoSync(refCount, refCount-1))
+        else if (RefCount.CompareAndSet_Release(refCount, refCount-1))
         {
             break;
         }
@@ -701,7 +701,7 @@ void DeviceCreateDesc::Release()
             Ptr<DeviceManagerLock>  lockKeepAlive;
             Lock::Locker            deviceLockScope(GetLock());
 
-            if (!HandleCount.CompareAndSet_NoSync(handleCount, 0))
+            if (!HandleCount.CompareAndSet_Sync(handleCount, 0))
                 continue;
             
             OVR_ASSERT(pDevice == 0);
@@ -726,7 +726,7 @@ void DeviceCreateDesc::Release()
             // in case it might be enumerated again later.
             break;
         }
-        else if (HandleCount.CompareAndSet_NoSync(handleCount, handleCount-1))
+        else if (HandleCount.CompareAndSet_Release(handleCount, handleCount-1))
         {
             break;
         }
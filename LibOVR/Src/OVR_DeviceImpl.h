@@ -107,7 +107,7 @@ public:
     Lock                CreateLock;
     DeviceManagerImpl*  pManager;
 
-    DeviceManagerLock() : pManager(0) { }
+    DeviceManagerLock() : CreateLock(Lock::ShortSectionSpinCount), pManager(0) { }
 };
 
 
@@ -118,9 +118,6 @@ public:
         virtual void OnInputReport(UByte* pData, UInt32 length)
         { OVR_UNUSED2(pData, length); }
 
-        virtual UInt64 OnTicks(UInt64 ticksMks)
-        { OVR_UNUSED1(ticksMks);  return Timer::MksPerSecond * 1000; ; }
-
         enum HIDDeviceMessageType
         {
             HIDDeviceMessage_DeviceAdded    = 0,
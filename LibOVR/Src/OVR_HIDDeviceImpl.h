@@ -134,36 +134,22 @@ public:
     }
 
 
-    struct WriteData
-    {
-        enum { BufferSize = 64 };
-        UByte Buffer[64];
-        UPInt Size;
-
-        WriteData(UByte* data, UPInt size) : Size(size)
-        {
-            OVR_ASSERT(size <= BufferSize);
-            memcpy(Buffer, data, size);
-        }
-    };
-
     bool SetFeatureReport(UByte* data, UInt32 length)
     { 
-        WriteData writeData(data, length);
-
-        // Push call with wait.
+        // Push call with wait. The caller's buffer outlives the call, so it is
+        // passed through rather than copied into the command.
         bool result = false;
 
 		ThreadCommandQueue* pQueue = this->GetManagerImpl()->GetThreadQueue();
-        if (!pQueue->PushCallAndWaitResult(this, &HIDDeviceImpl::setFeatureReport, &result, writeData))
+        if (!pQueue->PushCallAndWaitResult(this, &HIDDeviceImpl::setFeatureReport, &result, data, length))
             return false;
 
         return result;
     }
 
-    bool setFeatureReport(const WriteData& data)
+    bool setFeatureReport(UByte* data, UInt32 length)
     {
-        return InternalDevice->SetFeatureReport((UByte*) data.Buffer, (UInt32) data.Size);
+        return InternalDevice->SetFeatureReport(data, length);
     }
 
     bool GetFeatureReport(UByte* data, UInt32 length)
@@ -191,23 +191,29 @@ int DeviceManagerThread::Run()
             bool commands = 0;
             do
             {
-                int waitMs = -1;
+                UInt64 ticksMks = Timer::GetTicks();
+
+                // Go back to PopCommand once a scheduled call is due; otherwise wait
+                // no longer than until the next one.
+                UInt64 waitMks = GetScheduledCallDelay(ticksMks);
+                if (waitMks == 0)
+                    break;
 
                 // If devices have time-dependent logic registered, get the longest wait
                 // allowed based on current ticks.
-                if (!TicksNotifiers.IsEmpty())
+                for (UPInt j = 0; j < TicksNotifiers.GetSize(); j++)
                 {
-                    UInt64 ticksMks = Timer::GetTicks();
-                    int  waitAllowed;
-
-                    for (UPInt j = 0; j < TicksNotifiers.GetSize(); j++)
-                    {
-                        waitAllowed = (int)(TicksNotifiers[j]->OnTicks(ticksMks) / Timer::MksPerMs);
-                        if (waitAllowed < waitMs)
-                            waitMs = waitAllowed;
-                    }
+                    UInt64 waitAllowed = TicksNotifiers[j]->OnTicks(ticksMks);
+                    if (waitAllowed < waitMks)
+                        waitMks = waitAllowed;
                 }
 
+                // Round up, so that the wait doesn't end just short of the deadline.
+                // MksPerSecond * 1000 means nothing is scheduled, so block until signaled.
+                int waitMs = -1;
+                if (waitMks < Timer::MksPerSecond * 1000)
+                    waitMs = (int)((waitMks + Timer::MksPerMs - 1) / Timer::MksPerMs);
+
                 // wait until there is data available on one of the devices or the timeout expires
                 int n = poll(&PollFds[0], PollFds.GetSize(), waitMs);
 
@@ -447,7 +447,6 @@ bool HIDDevice::HIDInitialize(const String& path)
         return false;
     }
     
-    HIDManager->DevManager->pThread->AddTicksNotifier(this);
     HIDManager->AddNotificationDevice(this);
 
     LogText("OVR::Linux::HIDDevice - Opened '%s'\n"
@@ -578,7 +577,6 @@ bool HIDDevice::openDevice(const char* device_path)
 void HIDDevice::HIDShutdown()
 {
 
-    HIDManager->DevManager->pThread->RemoveTicksNotifier(this);
     HIDManager->RemoveNotificationDevice(this);
     
     if (DeviceHandle >= 0) // Device may already have been closed if unplugged.
@@ -640,17 +638,6 @@ bool HIDDevice::GetFeatureReport(UByte* data, UInt32 length)
     return (r >= 0);
 }
 
-//-----------------------------------------------------------------------------
-UInt64 HIDDevice::OnTicks(UInt64 ticksMks)
-{
-    if (Handler)
-    {
-        return Handler->OnTicks(ticksMks);
-    }
-    
-    return DeviceManagerThread::Notifier::OnTicks(ticksMks);
-}
-
 //-----------------------------------------------------------------------------
 void HIDDevice::OnEvent(int i, int fd)
 {
@@ -48,7 +48,6 @@ public:
 
     // DeviceManagerThread::Notifier
     void OnEvent(int i, int fd);
-    UInt64 OnTicks(UInt64 ticksMks);
 
     bool OnDeviceNotification(MessageType messageType,
                               HIDDeviceDesc* device_info,
@@ -194,22 +194,28 @@ int DeviceManagerThread::Run()
             SInt32 exitReason = 0;
             do {
 
-                UInt32 waitMs = INT_MAX;
+                UInt64 ticksMks = Timer::GetTicks();
+
+                // Go back to PopCommand once a scheduled call is due; otherwise wait
+                // no longer than until the next one.
+                UInt64 waitMks = GetScheduledCallDelay(ticksMks);
+                if (waitMks == 0)
+                    break;
 
                 // If devices have time-dependent logic registered, get the longest wait
                 // allowed based on current ticks.
-                if (!TicksNotifiers.IsEmpty())
+                for (UPInt j = 0; j < TicksNotifiers.GetSize(); j++)
                 {
-                    UInt64 ticksMks = Timer::GetTicks();
-                    UInt32  waitAllowed;
-
-                    for (UPInt j = 0; j < TicksNotifiers.GetSize(); j++)
-                    {
-                        waitAllowed = (UInt32)(TicksNotifiers[j]->OnTicks(ticksMks) / Timer::MksPerMs);
-                        if (waitAllowed < waitMs)
-                            waitMs = waitAllowed;
-                    }
+                    UInt64 waitAllowed = TicksNotifiers[j]->OnTicks(ticksMks);
+                    if (waitAllowed < waitMks)
+                        waitMks = waitAllowed;
                 }
+
+                // Round up, so that the wait doesn't end just short of the deadline.
+                // MksPerSecond * 1000 means nothing is scheduled, so block until signaled.
+                UInt32 waitMs = INT_MAX;
+                if (waitMks < Timer::MksPerSecond * 1000)
+                    waitMs = (UInt32)((waitMks + Timer::MksPerMs - 1) / Timer::MksPerMs);
                 
                 // Enter blocking run loop. We may continue until we timeout in which
                 // case it's time to service the ticks. Or if commands arrive in the command
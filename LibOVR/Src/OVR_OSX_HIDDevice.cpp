@@ -472,8 +472,6 @@ bool HIDDevice::HIDInitialize(const String& path)
         return false;
     }
     
-    HIDManager->DevManager->pThread->AddTicksNotifier(this);
-
     
     LogText("OVR::OSX::HIDDevice - Opened '%s'\n"
             "                    Manufacturer:'%s'  Product:'%s'  Serial#:'%s'\n",
@@ -641,8 +639,6 @@ bool HIDDevice::openDevice()
 void HIDDevice::HIDShutdown()
 {
 
-    HIDManager->DevManager->pThread->RemoveTicksNotifier(this);
-    
     if (Device != NULL) // Device may already have been closed if unplugged.
     {
         closeDevice(false);
@@ -822,17 +818,6 @@ bool HIDDevice::GetFeatureReport(UByte* data, UInt32 length)
     return (result == kIOReturnSuccess);
 }
    
-UInt64 HIDDevice::OnTicks(UInt64 ticksMks)
-{
-    
-    if (Handler)
-    {
-        return Handler->OnTicks(ticksMks);
-    }
-    
-    return DeviceManagerThread::Notifier::OnTicks(ticksMks);
-}
-
 HIDDeviceManager* HIDDeviceManager::CreateInternal(OSX::DeviceManager* devManager)
 {
         
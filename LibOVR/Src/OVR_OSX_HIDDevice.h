@@ -53,10 +53,6 @@ public:
     bool Read(UByte* pData, UInt32 length, UInt32 timeoutMilliS);
     bool ReadBlocking(UByte* pData, UInt32 length);
 
-
-    // DeviceManagerThread::Notifier
-    UInt64 OnTicks(UInt64 ticksMks);
-    
 private:
     bool initInfo();
     bool openDevice();
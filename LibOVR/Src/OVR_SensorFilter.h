@@ -18,80 +18,625 @@ otherwise accompanies this software in either electronic or hard copy form.
 #define OVR_SensorFilter_h
 
 #include "Kernel/OVR_Math.h"
+#include <string.h>
 
 
 namespace OVR {
 
-// This class maintains a sliding window of sensor data taken over time and implements
-// various simple filters, most of which are linear functions of the data history.
-class SensorFilter
+//-------------------------------------------------------------------------------------
+// ***** SavitzkyGolayKernel
+
+// Weights of a Savitzky-Golay filter: a least squares fit of a polynomial of the given
+// order over the last windowSize samples, evaluated (derivative == 0) or differentiated
+// at the newest sample. Derivatives are per sample step. Computing the weights involves
+// solving a small linear system, so kernels should be created once and reused with
+// SensorFilterBase::SavitzkyGolay.
+class SavitzkyGolayKernel
 {
+public:
     enum
     {
-        MaxFilterSize     = 100,
-        DefaultFilterSize = 20
+        MaxWindowSize = 128,
+        MaxPolyOrder  = 8
     };
 
+    SavitzkyGolayKernel(int windowSize, int polyOrder, int derivative = 0);
+
+    int          GetWindowSize() const          { return WindowSize; }
+    // Weight applied to GetPrev(i).
+    float        GetCoefficient(int i) const    { return Coefficients[WindowSize - 1 - i]; }
+    // All weights, oldest sample first.
+    const float* GetCoefficients() const        { return Coefficients; }
+
 private:
-    int         LastIdx;                    // The index of the last element that was added to the array
-    int         Size;                       // The window size (number of elements)
-    Vector3f    Elements[MaxFilterSize]; 
+    int     WindowSize;
+    float   Coefficients[MaxWindowSize];
+};
+
+
+//-------------------------------------------------------------------------------------
+// ***** SensorFilterBase
 
+// SensorFilterBase maintains a sliding window of 3D sensor samples with components of
+// type T, taken over time, and implements various simple filters, most of which are
+// linear functions of the data history.
+//
+// Storage is a ring of Capacity elements; Capacity must be a power of two so that
+// indexing is a masked load. The window size can be set at construction to anything
+// up to Capacity, so a filter should be instantiated with the smallest capacity that
+// covers the sizes it will be used with.
+//
+// Sums and cross-products of the samples in the window are updated as elements are
+// added, so Total, Mean, Variance and Covariance are O(1). They only cover the samples
+// inserted so far if the window has not filled yet. The sums are kept in double and
+// recomputed from the window every ResyncPeriod insertions to bound the error from
+// repeated adds and subtracts. Samples are stored as one ring per axis, so that kernel
+// filters reduce to plain dot products. Median selects from a copy of the window on
+// each call, which is O(n); SensorFilterMedian keeps it up to date instead.
+template<class T, int Capacity>
+class SensorFilterBase
+{
 public:
-    // Create a new filter with default size
-    SensorFilter() 
+    typedef Vector3<T> ValueType;
+
+    enum
     {
-        LastIdx = -1;
-        Size = DefaultFilterSize;
+        MaxFilterSize     = Capacity,
+        DefaultFilterSize = (Capacity < 20) ? Capacity : 20,
+        ResyncPeriod      = 1024
     };
 
+protected:
+    enum { IndexMask = Capacity - 1 };
+
+    unsigned    LastIdx;                    // The index of the last element that was added to the array
+    int         Size;                       // The window size (number of elements)
+    int         Count;                      // Number of valid elements, up to Size
+    int         SinceResync;                // Insertions since the sums were last recomputed
+    T           ElementsX[Capacity];
+    T           ElementsY[Capacity];
+    T           ElementsZ[Capacity];
+
+    // Running sums over the valid elements: x, y, z and xx, yy, zz, xy, yz, zx.
+    double      Sum[3];
+    double      SumSq[6];
+
+    // Returns the k-th smallest of a[0..n-1], reordering a.
+    static T    selectNth(T* a, int n, int k);
+
+    void addToSums(const ValueType& e, double sign)
+    {
+        double x = e.x, y = e.y, z = e.z;
+        Sum[0]   += sign * x;
+        Sum[1]   += sign * y;
+        Sum[2]   += sign * z;
+        SumSq[0] += sign * x * x;
+        SumSq[1] += sign * y * y;
+        SumSq[2] += sign * z * z;
+        SumSq[3] += sign * x * y;
+        SumSq[4] += sign * y * z;
+        SumSq[5] += sign * z * x;
+    }
+
+    ValueType getElement(unsigned idx) const
+    {
+        return ValueType(ElementsX[idx], ElementsY[idx], ElementsZ[idx]);
+    }
+
+    void clearSums()
+    {
+        Count = 0;
+        SinceResync = 0;
+        for (int i = 0; i < 3; i++)
+            Sum[i] = 0.0;
+        for (int i = 0; i < 6; i++)
+            SumSq[i] = 0.0;
+    }
+
+    void resync()
+    {
+        int count = Count;
+        clearSums();
+        Count = count;
+        for (int i = 0; i < Count; i++)
+            addToSums(GetPrev(i), 1.0);
+    }
+
+public:
     // Create a new filter with size i
-    SensorFilter(int i) 
+    SensorFilterBase(int i = DefaultFilterSize) 
     {
-        OVR_ASSERT(i <= MaxFilterSize);
-        LastIdx = -1;
+        OVR_COMPILER_ASSERT((Capacity & (Capacity - 1)) == 0);
+        OVR_ASSERT(i > 0 && i <= Capacity);
+        LastIdx = IndexMask;
         Size = i;
+        clearSums();
+        memset(ElementsX, 0, sizeof(ElementsX));
+        memset(ElementsY, 0, sizeof(ElementsY));
+        memset(ElementsZ, 0, sizeof(ElementsZ));
     };
 
 
     // Create a new element to the filter
-    void AddElement (const Vector3f &e) 
+    void AddElement (const ValueType &e) 
     {
-        if (LastIdx == Size - 1) 
-            LastIdx = 0;
-        else                            
-            LastIdx++;
+        LastIdx = (LastIdx + 1) & IndexMask;
+
+        // The element leaving the window is Size slots behind the new one.
+        if (Count == Size)
+        {
+            addToSums(getElement((LastIdx - Size) & IndexMask), -1.0);
+            Count--;
+        }
 
-        Elements[LastIdx] = e;
+        ElementsX[LastIdx] = e.x;
+        ElementsY[LastIdx] = e.y;
+        ElementsZ[LastIdx] = e.z;
+        addToSums(e, 1.0);
+        Count++;
+
+        if (++SinceResync >= ResyncPeriod)
+            resync();
     };
 
+    // Window size (number of elements)
+    int GetSize() const { return Size; }
+
+    // Number of elements added so far, up to the window size
+    int GetCount() const { return Count; }
+
     // Get element i.  0 is the most recent, 1 is one step ago, 2 is two steps ago, ...
-    Vector3f GetPrev(int i) const
-    {
-		OVR_ASSERT(i >= 0); // 
-        int idx = (LastIdx - i);
-        if (idx < 0) // Fix the wraparound case
-            idx += Size;
-		OVR_ASSERT(idx >= 0); // Multiple wraparounds not allowed
-        return Elements[idx];
+    ValueType GetPrev(int i) const
+    {
+        OVR_ASSERT(i >= 0 && i < Size);
+        return getElement((LastIdx - i) & IndexMask);
     };
 
     // Simple statistics
-    Vector3f Total() const;
-    Vector3f Mean() const;
-    Vector3f Median() const;
-    Vector3f Variance() const; // The diagonal of covariance matrix
-    Matrix4f Covariance() const;
-    Vector3f PearsonCoefficient() const;
+    ValueType Total() const
+    {
+        return ValueType((T)Sum[0], (T)Sum[1], (T)Sum[2]);
+    }
+
+    ValueType Mean() const
+    {
+        if (Count == 0)
+            return ValueType(0, 0, 0);
+        double inv = 1.0 / Count;
+        return ValueType((T)(Sum[0] * inv), (T)(Sum[1] * inv), (T)(Sum[2] * inv));
+    }
+
+    // Upper median for an even number of elements.
+    ValueType Median() const;
+
+    ValueType Variance() const; // The diagonal of covariance matrix
+    Matrix4f  Covariance() const;
+    ValueType PearsonCoefficient() const;
 
     // A popular family of smoothing filters and smoothed derivatives
-    Vector3f SavitzkyGolaySmooth8() const;
-    Vector3f SavitzkyGolayDerivative4() const;
-    Vector3f SavitzkyGolayDerivative5() const;
-    Vector3f SavitzkyGolayDerivative12() const; 
-    Vector3f SavitzkyGolayDerivativeN(int n) const;
+    ValueType SavitzkyGolaySmooth8() const;
+    ValueType SavitzkyGolayDerivative4() const;
+    ValueType SavitzkyGolayDerivative5() const;
+    ValueType SavitzkyGolayDerivative12() const; 
+    ValueType SavitzkyGolayDerivativeN(int n) const;
+
+    // Applies a general Savitzky-Golay kernel to the newest kernel.GetWindowSize()
+    // samples; the window size must not exceed the filter size.
+    ValueType SavitzkyGolay(const SavitzkyGolayKernel& kernel) const;
+
+    ~SensorFilterBase() {};
+};
+
+
+template<class T, int Capacity>
+T SensorFilterBase<T, Capacity>::selectNth(T* a, int n, int k)
+{
+    // Hoare partitioning around the middle element; each pass keeps the side holding k.
+    int lo = 0, hi = n - 1;
+    while (lo < hi)
+    {
+        T   pivot = a[k];
+        int i = lo, j = hi;
+        do
+        {
+            while (a[i] < pivot)
+                i++;
+            while (pivot < a[j])
+                j--;
+            if (i <= j)
+            {
+                T t = a[i];
+                a[i++] = a[j];
+                a[j--] = t;
+            }
+        } while (i <= j);
+
+        if (j < k)
+            lo = i;
+        if (k < i)
+            hi = j;
+    }
+    return a[k];
+}
+
+template<class T, int Capacity>
+Vector3<T> SensorFilterBase<T, Capacity>::Median() const
+{
+    if (Count == 0)
+        return ValueType(0, 0, 0);
+
+    T   x[Capacity], y[Capacity], z[Capacity];
+    for (int i = 0; i < Count; i++)
+    {
+        unsigned idx = (LastIdx - i) & IndexMask;
+        x[i] = ElementsX[idx];
+        y[i] = ElementsY[idx];
+        z[i] = ElementsZ[idx];
+    }
+    int half = Count / 2;
+    return ValueType(selectNth(x, Count, half), selectNth(y, Count, half),
+                     selectNth(z, Count, half));
+}
+
+//  Only the diagonal of the covariance matrix.
+template<class T, int Capacity>
+Vector3<T> SensorFilterBase<T, Capacity>::Variance() const
+{
+    Matrix4f cov = Covariance();
+    return ValueType(cov.M[0][0], cov.M[1][1], cov.M[2][2]);
+}
+
+// Should be a 3x3 matrix returned, but OVR_math.h doesn't have one
+template<class T, int Capacity>
+Matrix4f SensorFilterBase<T, Capacity>::Covariance() const
+{
+    Matrix4f total = Matrix4f(0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0);
+    if (Count == 0)
+        return total;
+
+    // E[ab] - E[a]E[b]; the diagonal is clamped since rounding can make it negative.
+    double inv  = 1.0 / Count;
+    double mx   = Sum[0] * inv, my = Sum[1] * inv, mz = Sum[2] * inv;
+    double varX = SumSq[0] * inv - mx * mx;
+    double varY = SumSq[1] * inv - my * my;
+    double varZ = SumSq[2] * inv - mz * mz;
+
+    total.M[0][0] = (float)((varX > 0.0) ? varX : 0.0);
+    total.M[1][1] = (float)((varY > 0.0) ? varY : 0.0);
+    total.M[2][2] = (float)((varZ > 0.0) ? varZ : 0.0);
+    total.M[1][0] = total.M[0][1] = (float)(SumSq[3] * inv - mx * my);
+    total.M[2][1] = total.M[1][2] = (float)(SumSq[4] * inv - my * mz);
+    total.M[2][0] = total.M[0][2] = (float)(SumSq[5] * inv - mz * mx);
+    return total;
+}
+
+template<class T, int Capacity>
+Vector3<T> SensorFilterBase<T, Capacity>::PearsonCoefficient() const
+{
+    Matrix4f  cov = Covariance();
+    ValueType pearson = ValueType();
+    pearson.x = cov.M[0][1]/(sqrt(cov.M[0][0])*sqrt(cov.M[1][1]));
+    pearson.y = cov.M[1][2]/(sqrt(cov.M[1][1])*sqrt(cov.M[2][2]));
+    pearson.z = cov.M[2][0]/(sqrt(cov.M[2][2])*sqrt(cov.M[0][0]));
+
+    return pearson;
+}
+
+
+template<class T, int Capacity>
+Vector3<T> SensorFilterBase<T, Capacity>::SavitzkyGolaySmooth8() const
+{
+    OVR_ASSERT(Size >= 8);
+    return GetPrev(0)*0.41667f +
+            GetPrev(1)*0.33333f +
+            GetPrev(2)*0.25f +
+            GetPrev(3)*0.16667f +
+            GetPrev(4)*0.08333f -
+            GetPrev(6)*0.08333f -
+            GetPrev(7)*0.16667f;
+}
 
-    ~SensorFilter() {};
+
+template<class T, int Capacity>
+Vector3<T> SensorFilterBase<T, Capacity>::SavitzkyGolayDerivative4() const
+{
+    OVR_ASSERT(Size >= 4);
+    return GetPrev(0)*0.3f +
+            GetPrev(1)*0.1f -
+            GetPrev(2)*0.1f -
+            GetPrev(3)*0.3f;
+}
+
+template<class T, int Capacity>
+Vector3<T> SensorFilterBase<T, Capacity>::SavitzkyGolayDerivative5() const
+{
+    OVR_ASSERT(Size >= 5);
+    return GetPrev(0)*0.2f +
+            GetPrev(1)*0.1f -
+            GetPrev(3)*0.1f -
+            GetPrev(4)*0.2f;
+}
+
+template<class T, int Capacity>
+Vector3<T> SensorFilterBase<T, Capacity>::SavitzkyGolayDerivative12() const
+{
+    OVR_ASSERT(Size >= 12);
+    return GetPrev(0)*0.03846f +
+            GetPrev(1)*0.03147f +
+            GetPrev(2)*0.02448f +
+            GetPrev(3)*0.01748f +
+            GetPrev(4)*0.01049f +
+            GetPrev(5)*0.0035f -
+            GetPrev(6)*0.0035f -
+            GetPrev(7)*0.01049f -
+            GetPrev(8)*0.01748f -
+            GetPrev(9)*0.02448f -
+            GetPrev(10)*0.03147f -
+            GetPrev(11)*0.03846f;
+}
+
+template<class T, int Capacity>
+Vector3<T> SensorFilterBase<T, Capacity>::SavitzkyGolayDerivativeN(int n) const
+{    
+    OVR_ASSERT(Size >= n);
+    int m = (n-1)/2;
+    ValueType result = ValueType();
+    for (int k = 1; k <= m; k++) 
+    {
+        int ind1 = m - k;
+        int ind2 = n - m + k - 1;
+        result += (GetPrev(ind1) - GetPrev(ind2)) * (T) k;
+    }
+    T coef = (T)3.0/(m*(m+(T)1.0)*((T)2.0*m+(T)1.0));
+    result = result*coef;
+    return result;
+}
+
+
+template<class T, int Capacity>
+Vector3<T> SensorFilterBase<T, Capacity>::SavitzkyGolay(const SavitzkyGolayKernel& kernel) const
+{
+    int          n = kernel.GetWindowSize();
+    const float* c = kernel.GetCoefficients();
+    OVR_ASSERT(n <= Size);
+
+    // The window starts at the oldest sample and may wrap around the end of the ring,
+    // which leaves two contiguous runs.
+    unsigned start = (LastIdx - n + 1) & IndexMask;
+    int      run   = Capacity - (int)start;
+    if (run > n)
+        run = n;
+
+    T x = 0, y = 0, z = 0;
+    for (int i = 0; i < run; i++)
+    {
+        x += c[i] * ElementsX[start + i];
+        y += c[i] * ElementsY[start + i];
+        z += c[i] * ElementsZ[start + i];
+    }
+    c += run;
+    for (int i = 0; i < n - run; i++)
+    {
+        x += c[i] * ElementsX[i];
+        y += c[i] * ElementsY[i];
+        z += c[i] * ElementsZ[i];
+    }
+    return ValueType(x, y, z);
+}
+
+
+//-------------------------------------------------------------------------------------
+// ***** SensorFilterMedian
+
+// SensorFilterMedian is a SensorFilterBase that can also keep the median of its window
+// up to date, for filters whose Median is read often. Each axis is split into a max-heap
+// of the lower half of the window and a min-heap of the upper half, holding ring
+// indices; every element's heap slot is tracked so that the one leaving the window can
+// be removed directly. Insertion and eviction are O(log n) and Median is O(1).
+//
+// Tracking is off unless enabled, in which case Median falls back to selection.
+template<class T, int Capacity>
+class SensorFilterMedian : public SensorFilterBase<T, Capacity>
+{
+    typedef SensorFilterBase<T, Capacity> BaseType;
+
+public:
+    typedef typename BaseType::ValueType ValueType;
+
+private:
+    // Median tracking for one axis. Heap entries and slots fit in a byte; the top bit
+    // of a slot tells which heap it is in.
+    class AxisHeaps
+    {
+        enum { HighFlag = 0x80, SlotMask = 0x7F };
+
+        UByte   Low[Capacity];      // Max-heap of the lower half
+        UByte   High[Capacity];     // Min-heap of the upper half; at most one larger
+        UByte   Slot[Capacity];     // Heap slot of each ring index
+        int     LowCount, HighCount;
+
+        UByte*  heap(bool high)             { return high ? High : Low; }
+        int&    count(bool high)            { return high ? HighCount : LowCount; }
+
+        // Whether ring index a belongs closer to the top of the heap than b.
+        static bool above(const T* v, bool high, unsigned a, unsigned b)
+        { return high ? (v[a] < v[b]) : (v[b] < v[a]); }
+
+        void place(bool high, int slot, unsigned idx)
+        {
+            heap(high)[slot] = (UByte)idx;
+            Slot[idx]        = (UByte)(slot | (high ? HighFlag : 0));
+        }
+
+        void siftUp(const T* v, bool high, int slot)
+        {
+            UByte*   h   = heap(high);
+            unsigned idx = h[slot];
+            while (slot > 0)
+            {
+                int parent = (slot - 1) >> 1;
+                if (!above(v, high, idx, h[parent]))
+                    break;
+                place(high, slot, h[parent]);
+                slot = parent;
+            }
+            place(high, slot, idx);
+        }
+
+        void siftDown(const T* v, bool high, int slot)
+        {
+            UByte*   h   = heap(high);
+            int      n   = count(high);
+            unsigned idx = h[slot];
+            for (;;)
+            {
+                int child = 2 * slot + 1;
+                if (child >= n)
+                    break;
+                if ((child + 1 < n) && above(v, high, h[child + 1], h[child]))
+                    child++;
+                if (!above(v, high, h[child], idx))
+                    break;
+                place(high, slot, h[child]);
+                slot = child;
+            }
+            place(high, slot, idx);
+        }
+
+        void push(const T* v, bool high, unsigned idx)
+        {
+            int slot = count(high)++;
+            place(high, slot, idx);
+            siftUp(v, high, slot);
+        }
+
+        void removeAt(const T* v, bool high, int slot)
+        {
+            UByte* h    = heap(high);
+            int    last = --count(high);
+            if (slot == last)
+                return;
+            place(high, slot, h[last]);
+            if ((slot > 0) && above(v, high, h[slot], h[(slot - 1) >> 1]))
+                siftUp(v, high, slot);
+            else
+                siftDown(v, high, slot);
+        }
+
+        // Moves the top of one heap to the other until High holds the upper median.
+        void rebalance(const T* v)
+        {
+            while (LowCount > HighCount)
+            {
+                unsigned idx = Low[0];
+                removeAt(v, false, 0);
+                push(v, true, idx);
+            }
+            while (HighCount > LowCount + 1)
+            {
+                unsigned idx = High[0];
+                removeAt(v, true, 0);
+                push(v, false, idx);
+            }
+        }
+
+    public:
+        void Clear()    { LowCount = HighCount = 0; }
+
+        void Insert(const T* v, unsigned idx)
+        {
+            push(v, (HighCount == 0) || !(v[idx] < v[High[0]]), idx);
+            rebalance(v);
+        }
+
+        void Remove(const T* v, unsigned idx)
+        {
+            removeAt(v, (Slot[idx] & HighFlag) != 0, Slot[idx] & SlotMask);
+            rebalance(v);
+        }
+
+        T Median(const T* v) const  { return v[High[0]]; }
+    };
+
+    bool        TrackMedian;
+    AxisHeaps   Heaps[3];
+
+    const T*    axis(int i) const
+    { return (i == 0) ? this->ElementsX : ((i == 1) ? this->ElementsY : this->ElementsZ); }
+
+    void rebuildHeaps()
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            Heaps[a].Clear();
+            for (int i = this->Count - 1; i >= 0; i--)
+                Heaps[a].Insert(axis(a), (this->LastIdx - i) & BaseType::IndexMask);
+        }
+    }
+
+public:
+    SensorFilterMedian(int i = BaseType::DefaultFilterSize, bool trackMedian = false)
+        : BaseType(i), TrackMedian(trackMedian)
+    {
+        OVR_COMPILER_ASSERT(Capacity <= 128);
+        for (int a = 0; a < 3; a++)
+            Heaps[a].Clear();
+    }
+
+    bool IsMedianTracked() const    { return TrackMedian; }
+    // Enabling tracking builds the heaps from the current window.
+    void SetMedianTracked(bool track)
+    {
+        if (track && !TrackMedian)
+            rebuildHeaps();
+        TrackMedian = track;
+    }
+
+    void AddElement(const ValueType& e)
+    {
+        if (!TrackMedian)
+        {
+            BaseType::AddElement(e);
+            return;
+        }
+
+        // The leaving element may share its slot with the new one, so it goes first.
+        unsigned next = (this->LastIdx + 1) & BaseType::IndexMask;
+        if (this->Count == this->Size)
+        {
+            unsigned old = (next - this->Size) & BaseType::IndexMask;
+            for (int a = 0; a < 3; a++)
+                Heaps[a].Remove(axis(a), old);
+        }
+        BaseType::AddElement(e);
+        for (int a = 0; a < 3; a++)
+            Heaps[a].Insert(axis(a), next);
+    }
+
+    // Upper median for an even number of elements.
+    ValueType Median() const
+    {
+        if (!TrackMedian)
+            return BaseType::Median();
+        if (this->Count == 0)
+            return ValueType(0, 0, 0);
+        return ValueType(Heaps[0].Median(axis(0)), Heaps[1].Median(axis(1)),
+                         Heaps[2].Median(axis(2)));
+    }
+};
+
+
+//-------------------------------------------------------------------------------------
+// ***** SensorFilter
+
+// General purpose filter over Vector3f samples with window sizes of up to 128.
+class SensorFilter : public SensorFilterBase<float, 128>
+{
+public:
+    // Create a new filter with default size
+    SensorFilter() { }
+    // Create a new filter with size i
+    SensorFilter(int i) : SensorFilterBase<float, 128>(i) { }
 };
 
 } //namespace OVR
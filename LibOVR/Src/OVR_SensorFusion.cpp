@@ -16,6 +16,16 @@ otherwise accompanies this software in either electronic or hard copy form.
 #include "OVR_SensorFusion.h"
 #include "Kernel/OVR_Log.h"
 #include "Kernel/OVR_System.h"
+#include "Kernel/OVR_Timer.h"
+
+// Stage timing markers; each STAGE_END records the span since the previous marker.
+#if OVR_SENSORFUSION_PROFILE
+    #define OVR_FUSION_STAGE_BEGIN()        UInt64 stageStart = Timer::GetCycleCount()
+    #define OVR_FUSION_STAGE_END(stage)     stageStart = recordStage(stage, stageStart)
+#else
+    #define OVR_FUSION_STAGE_BEGIN()        ((void)0)
+    #define OVR_FUSION_STAGE_END(stage)     ((void)0)
+#endif
 
 namespace OVR {
 
@@ -23,17 +33,23 @@ namespace OVR {
 // ***** Sensor Fusion
 
 SensorFusion::SensorFusion(SensorDevice* sensor)
-  : Handler(getThis()), pDelegate(0),
-    Gain(0.05f), YawMult(1), EnableGravity(true), Stage(0), RunningTime(0), DeltaT(0.001f),
+  : EnableDoublePrecision(false), Handler(getThis()), pDelegate(0),
+    Gain(0.05f), YawMult(1), EnableGravity(true), Stage(0), RunningTime(0), TiltSnapClock(0),
+    DeltaT(0.001f),
 	EnablePrediction(true), PredictionDT(0.03f), PredictionTimeIncrement(0.001f),
-    FRawMag(10), FAccW(20), FAngV(20),
+    FRawMag(Tuning.MagFilterSize, Tuning.UseMedianFilter),
+    FAccW(Tuning.AccelFilterSize, Tuning.UseMedianFilter), FAngV(Tuning.AngVelFilterSize),
     TiltCondCount(0), TiltErrorAngle(0), 
-    TiltErrorAxis(0,1,0),
+    TiltErrorAxis(0,1,0), TiltStepFraction(0), TiltDeferredSteps(0), TiltErrorStale(false),
+    YawDeferredSteps(0),
     MagCondCount(0), MagCalibrated(false), MagRefQ(0, 0, 0, 1), 
 	MagRefM(0), MagRefYaw(0), YawErrorAngle(0), MagRefDistance(0.5f),
     YawErrorCount(0), YawCorrectionActivated(false), YawCorrectionInProgress(false), 
 	EnableYawCorrection(false), MagNumReferences(0), MagHasNearbyReference(false)
 {
+#if OVR_SENSORFUSION_PROFILE
+   ResetStageStats();
+#endif
    if (sensor)
        AttachToSensor(sensor);
    MagCalibrationMatrix.SetIdentity();
@@ -86,10 +102,39 @@ void SensorFusion::Reset()
     Lock::Locker lockScope(Handler.GetHandlerLock());
     Q                     = Quatf();
     QUncorrected          = Quatf();
+    QAccum                = Quatd();
     Stage                 = 0;
 	RunningTime           = 0;
-	MagNumReferences      = 0;
-	MagHasNearbyReference = false;
+    TiltSnapClock         = 0;
+	ClearMagReferences();
+}
+
+
+void SensorFusion::SetDoublePrecisionEnabled(bool enable)
+{
+    Lock::Locker lockScope(Handler.GetHandlerLock());
+    if (enable && !EnableDoublePrecision)
+        QAccum = Quatd(Q);
+    EnableDoublePrecision = enable;
+}
+
+
+void SensorFusion::SetTuning(const TuningParams& tuning)
+{
+    OVR_ASSERT(tuning.AngVelFilterSize >= 8);
+    OVR_ASSERT((tuning.MagFilterSize <= FilterCapacity) && (tuning.AccelFilterSize <= FilterCapacity) &&
+               (tuning.AngVelFilterSize <= FilterCapacity));
+    Lock::Locker lockScope(Handler.GetHandlerLock());
+
+    if (tuning.MagFilterSize != Tuning.MagFilterSize)
+        FRawMag = FusionMedianFilter(tuning.MagFilterSize);
+    if (tuning.AccelFilterSize != Tuning.AccelFilterSize)
+        FAccW = FusionMedianFilter(tuning.AccelFilterSize);
+    FRawMag.SetMedianTracked(tuning.UseMedianFilter);
+    FAccW.SetMedianTracked(tuning.UseMedianFilter);
+    if (tuning.AngVelFilterSize != Tuning.AngVelFilterSize)
+        FAngV = FusionFilter(tuning.AngVelFilterSize);
+    Tuning = tuning;
 }
 
 
@@ -97,6 +142,8 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
 {
     if (msg.Type != Message_BodyFrame)
         return;
+
+    OVR_FUSION_STAGE_BEGIN();
   
     // Put the sensor readings into convenient local variables
     Vector3f angVel    = msg.RotationRate; 
@@ -124,8 +171,10 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
     // (if the mag is not calibrated, then the raw value is returned)
     CalMag = mag;
 
-    float angVelLength = angVel.Length();
-    float accLength    = rawAccel.Length();
+    // Rate thresholds below are compared squared; the length itself is only needed
+    // when a tilt correction step is taken.
+    float angVelLengthSq = angVel.LengthSq();
+    float accLength      = rawAccel.Length();
 
 
     // Acceleration in the world frame (Q is current HMD orientation)
@@ -134,11 +183,14 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
     // Keep track of time
     Stage++;
     RunningTime += DeltaT;
+    TiltSnapClock += DeltaT;
+    OVR_FUSION_STAGE_END(FusionStage_Input);
 
     // Insert current sensor data into filter history
     FRawMag.AddElement(RawMag);
     FAccW.AddElement(accWorld);
     FAngV.AddElement(angVel);
+    OVR_FUSION_STAGE_END(FusionStage_FilterInsert);
 
     // Update orientation Q based on gyro outputs.  This technique is
     // based on direct properties of the angular velocity vector:
@@ -146,23 +198,29 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
     // is the rotation rate (rad/sec) about that axis.  Our sensor
     // sampling rate is so fast that we need not worry about integral
     // approximation error (not yet, anyway).
-    if (angVelLength > 0.0f)
+    // Per-sample steps are small enough for FromRotationVector to use its series.
+    if (EnableDoublePrecision)
     {
-        Vector3f     rotAxis      = angVel / angVelLength;  
-        float        halfRotAngle = angVelLength * DeltaT * 0.5f;
-        float        sinHRA       = sin(halfRotAngle);
-        Quatf        deltaQ(rotAxis.x*sinHRA, rotAxis.y*sinHRA, rotAxis.z*sinHRA, cos(halfRotAngle));
-
-        Q =  Q * deltaQ;
+        if (angVelLengthSq > 0.0f)
+            QAccum = QAccum * Quatd::FromRotationVector(Vector3d(angVel) * DeltaT);
+        if (Stage % 5000 == 0)
+            QAccum.Normalize();
+        Q = Quatf(QAccum);
     }
+    else
+    {
+        if (angVelLengthSq > 0.0f)
+            Q = Q * Quatf::FromRotationVector(angVel * DeltaT);
     
-    // The quaternion magnitude may slowly drift due to numerical error,
-    // so it is periodically normalized.
-    if (Stage % 5000 == 0)
-        Q.Normalize();
+        // The quaternion magnitude may slowly drift due to numerical error,
+        // so it is periodically normalized.
+        if (Stage % 5000 == 0)
+            Q.Normalize();
+    }
     
 	// Maintain the uncorrected orientation for later use by predictive filtering
 	QUncorrected = Q;
+    OVR_FUSION_STAGE_END(FusionStage_GyroIntegration);
 
     // Perform tilt correction using the accelerometer data. This enables 
     // drift errors in pitch and roll to be corrected. Note that yaw cannot be corrected
@@ -170,28 +228,22 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
     if (EnableGravity)
     {
         // Correcting for tilt error by using accelerometer data
-        const float  gravityEpsilon = 0.4f;
-        const float  angVelEpsilon  = 0.1f; // Relatively slow rotation
-        const int    tiltPeriod     = 50;   // Required time steps of stability
-        const float  maxTiltError   = 0.05f;
-        const float  minTiltError   = 0.01f;
-
         // This condition estimates whether the only measured acceleration is due to gravity 
         // (the Rift is not linearly accelerating).  It is often wrong, but tends to average
         // out well over time.
-        if ((fabs(accLength - 9.81f) < gravityEpsilon) &&
-            (angVelLength < angVelEpsilon))
+        if ((fabs(accLength - 9.81f) < Tuning.GravityEpsilon) &&
+            (angVelLengthSq < Tuning.AngVelEpsilon * Tuning.AngVelEpsilon))
             TiltCondCount++;
         else
             TiltCondCount = 0;
     
         // After stable measurements have been taken over a sufficiently long period,
         // estimate the amount of tilt error and calculate the tilt axis for later correction.
-        if (TiltCondCount >= tiltPeriod)
+        if (TiltCondCount >= Tuning.TiltPeriod)
         {   // Update TiltErrorEstimate
             TiltCondCount = 0;
             // Use an average value to reduce noise (could alternatively use an LPF)
-            Vector3f accWMean = FAccW.Mean();
+            Vector3f accWMean = Tuning.UseMedianFilter ? FAccW.Median() : FAccW.Mean();
             // Project the acceleration vector into the XZ plane
             Vector3f xzAcc = Vector3f(accWMean.x, 0.0f, accWMean.z);
             // The unit normal of xzAcc will be the rotation axis for tilt correction
@@ -199,21 +251,27 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
             Vector3f yUp = Vector3f(0.0f, 1.0f, 0.0f);
             // This is the amount of rotation
             float    tiltAngle = yUp.Angle(accWMean);
-            // Record values if the tilt error is intolerable
-            if (tiltAngle > maxTiltError) 
+            // Record values if the tilt error is intolerable, or replace a restored one
+            if ((tiltAngle > Tuning.MaxTiltError) || TiltErrorStale)
             {
                 TiltErrorAngle = tiltAngle;
                 TiltErrorAxis = tiltAxis;
+                // Pending steps were never applied, so the new estimate already covers them.
+                TiltStepFraction  = 0.0f;
+                TiltDeferredSteps = 0;
+                TiltErrorStale    = false;
             }
         }
 
         // This part performs the actual tilt correction as needed
-        if (TiltErrorAngle > minTiltError) 
+        if ((TiltErrorAngle > Tuning.MinTiltError) && !TiltErrorStale)
         {
-            if ((TiltErrorAngle > 0.4f)&&(RunningTime < 8.0f))
+            if ((TiltErrorAngle > Tuning.TiltSnapAngle)&&(TiltSnapClock < Tuning.TiltSnapTime))
             {   // Tilt completely to correct orientation
-                Q = Quatf(TiltErrorAxis, -TiltErrorAngle) * Q;
-                TiltErrorAngle = 0.0f;
+                applyCorrection(Quatf(TiltErrorAxis, -TiltErrorAngle));
+                TiltErrorAngle    = 0.0f;
+                TiltStepFraction  = 0.0f;
+                TiltDeferredSteps = 0;
             }
             else 
             {
@@ -221,33 +279,44 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
                 //        TiltErrorAngle,TiltErrorAxis.x,TiltErrorAxis.y,TiltErrorAxis.z);
                 //float deltaTiltAngle = -Gain*TiltErrorAngle*0.005f;
                 // This uses aggressive correction steps while your head is moving fast
-                float deltaTiltAngle = -Gain*TiltErrorAngle*0.005f*(5.0f*angVelLength+1.0f);
-                // Incrementally "un-tilt" by a small step size
-                Q = Quatf(TiltErrorAxis, deltaTiltAngle) * Q;
-                TiltErrorAngle += deltaTiltAngle;
+                float stepFraction = Gain*0.005f*(5.0f*sqrt(angVelLengthSq)+1.0f);
+                // Each step removes a fraction of the remaining error, so deferred steps
+                // compound: 1 - (1 - f1)(1 - f2)... of the error is removed in total.
+                TiltStepFraction += stepFraction - TiltStepFraction * stepFraction;
+
+                if (++TiltDeferredSteps >= Tuning.TiltCorrectionPeriod)
+                {
+                    float deltaTiltAngle = -TiltErrorAngle*TiltStepFraction;
+                    // Incrementally "un-tilt" by a small step size
+                    applyCorrection(Quatf(TiltErrorAxis, deltaTiltAngle));
+                    TiltErrorAngle   += deltaTiltAngle;
+                    TiltStepFraction  = 0.0f;
+                    TiltDeferredSteps = 0;
+                }
             }
         }
     }
+    OVR_FUSION_STAGE_END(FusionStage_TiltCorrection);
 
     // Yaw drift correction based on magnetometer data.  This corrects the part of the drift
     // that the accelerometer cannot handle.
     // This will only work if the magnetometer has been enabled, calibrated, and a reference
     // point has been set.
-    const float maxAngVelLength = 3.0f;
-    const int   magWindow = 5;
-    const float yawErrorMax = 0.1f;
-    const float yawErrorMin = 0.01f;
-    const int   yawErrorCountLimit = 50;
-    const float yawRotationStep = 0.00002f;
-
-    if (angVelLength < maxAngVelLength)
+    if (angVelLengthSq < Tuning.MaxAngVelLength * Tuning.MaxAngVelLength)
         MagCondCount++;
     else
         MagCondCount = 0;
 
+    // Reference lookup and yaw correction only run every YawCorrectionPeriod samples,
+    // covering the steps deferred since the last run.
+    int  yawSteps = ++YawDeferredSteps;
+    bool runYaw   = (yawSteps >= Tuning.YawCorrectionPeriod);
+    if (runYaw)
+        YawDeferredSteps = 0;
+
 	// Find, create, and utilize reference points for the magnetometer
 	// Need to be careful not to set reference points while there is significant tilt error
-    if ((EnableYawCorrection && MagCalibrated)&&(RunningTime > 10.0f)&&(TiltErrorAngle < 0.2f))
+    if (runYaw && (EnableYawCorrection && MagCalibrated)&&(RunningTime > Tuning.MagRefStartTime)&&(TiltErrorAngle < Tuning.MagRefMaxTilt))
 	{
 	  if (MagNumReferences == 0)
       {
@@ -256,40 +325,36 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
 	  else if (Q.Distance(MagRefQ) > MagRefDistance) 
       {
 		  MagHasNearbyReference = false;
-          float bestDist = 100000.0f;
-          int bestNdx = 0;
-          float dist;
-          for (int i = 0; i < MagNumReferences; i++)
-          {
-              dist = Q.Distance(MagRefTableQ[i]);
-              if (dist < bestDist)
-              {
-                  bestNdx = i;
-                  bestDist = dist;
-              }
-          }
+          int bestNdx = findNearestMagReference(Q);
 
-          if (bestDist < MagRefDistance)
+          if (bestNdx >= 0)
           {
+              const MagReference& ref = MagRefTable[bestNdx];
               MagHasNearbyReference = true;
-              MagRefQ   = MagRefTableQ[bestNdx];
-              MagRefM   = MagRefTableM[bestNdx];
-              MagRefYaw = MagRefTableYaw[bestNdx];
+              MagRefQ   = ref.Q;
+              MagRefM   = ref.M;
+              MagRefYaw = ref.Yaw;
               //LogText("Using reference %d\n",bestNdx);
           }
           else if (MagNumReferences < MagMaxReferences)
               SetMagReference();
 	  }
 	}
+    OVR_FUSION_STAGE_END(FusionStage_MagReference);
 
-	YawCorrectionInProgress = false;
-    if (EnableYawCorrection && MagCalibrated && (RunningTime > 2.0f) && (MagCondCount >= magWindow) &&
+    if (runYaw)
+        YawCorrectionInProgress = false;
+    if (runYaw && EnableYawCorrection && MagCalibrated && (RunningTime > Tuning.YawStartTime) && (MagCondCount >= Tuning.MagWindow) &&
         MagHasNearbyReference)
     {
+        // Only the deferred samples that met the mag conditions count as steps.
+        yawSteps = Alg::Min(yawSteps, MagCondCount - Tuning.MagWindow + 1);
+
         // Use rotational invariance to bring reference mag value into global frame
         Vector3f grefmag = MagRefQ.Rotate(GetCalibratedMagValue(MagRefM));
         // Bring current (averaged) mag reading into global frame
-        Vector3f gmag = Q.Rotate(GetCalibratedMagValue(FRawMag.Mean()));
+        Vector3f gmag = Q.Rotate(GetCalibratedMagValue(
+                            Tuning.UseMedianFilter ? FRawMag.Median() : FRawMag.Mean()));
         // Calculate the reference yaw in the global frame
         Anglef gryaw = Anglef(atan2(grefmag.x,grefmag.z));
         // Calculate the current yaw in the global frame
@@ -299,13 +364,13 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
 
         //LogText("Yaw error estimate: %f\n",YawErrorAngle.Get());
         // If the perceived error is large, keep count
-        if ((YawErrorAngle.Abs() > yawErrorMax) && (!YawCorrectionActivated))
-            YawErrorCount++;
+        if ((YawErrorAngle.Abs() > Tuning.YawErrorMax) && (!YawCorrectionActivated))
+            YawErrorCount += yawSteps;
         // After enough iterations of high perceived error, start the correction process
-        if (YawErrorCount > yawErrorCountLimit)
+        if (YawErrorCount > Tuning.YawErrorCountLimit)
             YawCorrectionActivated = true;
         // If the perceived error becomes small, turn off the yaw correction
-        if ((YawErrorAngle.Abs() < yawErrorMin) && YawCorrectionActivated) 
+        if ((YawErrorAngle.Abs() < Tuning.YawErrorMin) && YawCorrectionActivated) 
         {
             YawCorrectionActivated = false;
             YawErrorCount = 0;
@@ -316,9 +381,255 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
         {
 			YawCorrectionInProgress = true;
             // Incrementally "unyaw" by a small step size
-            Q = Quatf(Vector3f(0.0f,1.0f,0.0f), -yawRotationStep * YawErrorAngle.Sign()) * Q;
+            applyCorrection(Quatf(Vector3f(0.0f,1.0f,0.0f), -Tuning.YawRotationStep * yawSteps * YawErrorAngle.Sign()));
+        }
+    }
+    OVR_FUSION_STAGE_END(FusionStage_YawCorrection);
+}
+
+
+void SensorFusion::applyCorrection(const Quatf& dq)
+{
+    if (EnableDoublePrecision)
+    {
+        QAccum = Quatd(dq) * QAccum;
+        Q      = Quatf(QAccum);
+    }
+    else
+    {
+        Q = dq * Q;
+    }
+}
+
+
+void SensorFusion::FuseBatch(const MessageBodyFrame* msgs, UPInt count, Quatf* orientations)
+{
+    OVR_ASSERT(!IsAttachedToSensor());
+
+    if (orientations)
+    {
+        for (UPInt i = 0; i < count; i++)
+        {
+            handleMessage(msgs[i]);
+            orientations[i] = Q;
         }
     }
+    else
+    {
+        for (UPInt i = 0; i < count; i++)
+            handleMessage(msgs[i]);
+    }
+}
+
+
+
+//-------------------------------------------------------------------------------------
+// ***** State checkpoint
+
+enum
+{
+    FusionStateMagic   = 0x5346564F, // "OVFS"
+    FusionStateVersion = 5
+};
+
+// Sequential writer used by SaveState; with a null buffer it only counts bytes.
+class FusionStateWriter
+{
+public:
+    UByte*  pBuffer;
+    UPInt   Pos;
+
+    FusionStateWriter(UByte* buffer) : pBuffer(buffer), Pos(0) { }
+
+    template<class T>
+    void Write(const T& v)
+    {
+        if (pBuffer)
+            memcpy(pBuffer + Pos, &v, sizeof(T));
+        Pos += sizeof(T);
+    }
+
+    void WriteBool(bool v)
+    {
+        Write((UByte)(v ? 1 : 0));
+    }
+
+    // Filter history is stored oldest first, so it can be replayed with AddElement.
+    template<class F>
+    void WriteFilter(const F& f)
+    {
+        int count = f.GetCount();
+        Write(count);
+        for (int i = count - 1; i >= 0; i--)
+            Write(f.GetPrev(i));
+    }
+};
+
+class FusionStateReader
+{
+public:
+    const UByte* pBuffer;
+    UPInt        Size;
+    UPInt        Pos;
+
+    FusionStateReader(const UByte* buffer, UPInt size) : pBuffer(buffer), Size(size), Pos(0) { }
+
+    template<class T>
+    bool Read(T* v)
+    {
+        if (Size - Pos < sizeof(T))
+            return false;
+        memcpy(v, pBuffer + Pos, sizeof(T));
+        Pos += sizeof(T);
+        return true;
+    }
+
+    // Bools are stored as a byte; any value other than 0 reads as true.
+    bool ReadBool(bool* v)
+    {
+        UByte b;
+        if (!Read(&b))
+            return false;
+        *v = (b != 0);
+        return true;
+    }
+
+    template<class F>
+    bool ReadFilter(F* f)
+    {
+        int count;
+        if (!Read(&count) || (count < 0) || ((Size - Pos) / sizeof(Vector3f) < (UPInt)count))
+            return false;
+        for (int i = 0; i < count; i++)
+        {
+            Vector3f e;
+            Read(&e);
+            f->AddElement(e);
+        }
+        return true;
+    }
+};
+
+UPInt SensorFusion::SaveState(void* buffer, UPInt bufferSize) const
+{
+    Lock::Locker lockScope(Handler.GetHandlerLock());
+
+    // QAccum is only maintained in double precision mode; always store a usable one.
+    Quatd qAccum = EnableDoublePrecision ? QAccum : Quatd(Q);
+
+    // The first pass only measures; the second one writes if the buffer is big enough.
+    FusionStateWriter w(0);
+    while(1)
+    {
+        w.Write((UInt32)FusionStateMagic);
+        w.Write((UInt32)FusionStateVersion);
+        w.Write(Q);
+        w.Write(QUncorrected);
+        w.Write(qAccum);
+        w.Write(Stage);
+        w.Write(RunningTime);
+        w.Write(TiltErrorAngle);
+        w.Write(TiltErrorAxis);
+        w.Write(YawDeferredSteps);
+        w.WriteBool(MagCalibrated);
+        w.Write(MagCalibrationMatrix);
+        w.Write(MagCondCount);
+        w.Write(MagRefQ);
+        w.Write(MagRefM);
+        w.Write(MagRefYaw);
+        w.WriteBool(MagHasNearbyReference);
+        w.Write(YawErrorCount);
+        w.WriteBool(YawCorrectionActivated);
+        w.WriteFilter(FRawMag);
+        w.WriteFilter(FAngV);
+        w.Write(MagNumReferences);
+        for (int i = 0; i < MagNumReferences; i++)
+        {
+            w.Write(MagRefTable[i].Q);
+            w.Write(MagRefTable[i].M);
+            w.Write(MagRefTable[i].Yaw);
+        }
+
+        if (w.pBuffer || !buffer || (bufferSize < w.Pos))
+            return w.Pos;
+        w = FusionStateWriter((UByte*)buffer);
+    }
+}
+
+bool SensorFusion::RestoreState(const void* buffer, UPInt size)
+{
+    FusionStateReader r((const UByte*)buffer, size);
+    UInt32            magic = 0, version = 0;
+
+    if (!r.Read(&magic) || (magic != FusionStateMagic) ||
+        !r.Read(&version) || (version != FusionStateVersion))
+        return false;
+
+    // Decode into temporaries so that a truncated checkpoint leaves the state untouched.
+    Quatf        q, qUncorrected, magRefQ;
+    Quatd        qAccum;
+    unsigned int stage;
+    float        runningTime, tiltErrorAngle, magRefYaw;
+    int          yawDeferredSteps, magCondCount, yawErrorCount, numReferences;
+    Vector3f     tiltErrorAxis, magRefM;
+    bool         magCalibrated, magHasNearbyReference, yawCorrectionActivated;
+    Matrix4f     magCalibrationMatrix;
+    FusionMedianFilter fRawMag(FRawMag.GetSize(), FRawMag.IsMedianTracked());
+    FusionFilter       fAngV(FAngV.GetSize());
+
+    if (!r.Read(&q) || !r.Read(&qUncorrected) || !r.Read(&qAccum) || !r.Read(&stage) ||
+        !r.Read(&runningTime) || !r.Read(&tiltErrorAngle) || !r.Read(&tiltErrorAxis) ||
+        !r.Read(&yawDeferredSteps) ||
+        !r.ReadBool(&magCalibrated) || !r.Read(&magCalibrationMatrix) || !r.Read(&magCondCount) ||
+        !r.Read(&magRefQ) || !r.Read(&magRefM) || !r.Read(&magRefYaw) ||
+        !r.ReadBool(&magHasNearbyReference) || !r.Read(&yawErrorCount) ||
+        !r.ReadBool(&yawCorrectionActivated) ||
+        !r.ReadFilter(&fRawMag) || !r.ReadFilter(&fAngV) ||
+        !r.Read(&numReferences) || (numReferences < 0) || (numReferences > MagMaxReferences))
+        return false;
+
+    ArrayPOD<MagReference> refs;
+    refs.Resize(numReferences);
+    for (int i = 0; i < numReferences; i++)
+    {
+        if (!r.Read(&refs[i].Q) || !r.Read(&refs[i].M) || !r.Read(&refs[i].Yaw))
+            return false;
+    }
+
+    Lock::Locker lockScope(Handler.GetHandlerLock());
+    Q                      = q;
+    QUncorrected           = qUncorrected;
+    QAccum                 = qAccum;
+    Stage                  = stage;
+    RunningTime            = runningTime;
+    YawDeferredSteps       = yawDeferredSteps;
+    MagCalibrated          = magCalibrated;
+    MagCalibrationMatrix   = magCalibrationMatrix;
+    MagCondCount           = magCondCount;
+    MagRefQ                = magRefQ;
+    MagRefM                = magRefM;
+    MagRefYaw              = magRefYaw;
+    MagHasNearbyReference  = magHasNearbyReference;
+    YawErrorCount          = yawErrorCount;
+    YawCorrectionActivated = yawCorrectionActivated;
+    FRawMag                = fRawMag;
+    FAngV                  = fAngV;
+
+    // The headset may have moved while the checkpoint was stored, so the stored tilt
+    // error is not corrected for until it is estimated afresh, with the fast snap of a
+    // new session. Accel history and pending steps are from before the move.
+    TiltSnapClock          = 0;
+    TiltCondCount          = 0;
+    TiltErrorAngle         = tiltErrorAngle;
+    TiltErrorAxis          = tiltErrorAxis;
+    TiltErrorStale         = true;
+    TiltStepFraction       = 0;
+    TiltDeferredSteps      = 0;
+    FAccW                  = FusionMedianFilter(FAccW.GetSize(), FAccW.IsMedianTracked());
+
+    MagRefTable            = refs;
+    MagNumReferences       = numReferences;
+    return true;
 }
 
  
@@ -328,6 +639,7 @@ void SensorFusion::handleMessage(const MessageBodyFrame& msg)
 Quatf SensorFusion::GetPredictedOrientation(float pdt)
 {		
 	Lock::Locker lockScope(Handler.GetHandlerLock());
+    OVR_FUSION_STAGE_BEGIN();
 	Quatf        qP = QUncorrected;
 	
     if (EnablePrediction)
@@ -335,47 +647,86 @@ Quatf SensorFusion::GetPredictedOrientation(float pdt)
 #if 1
 		// This method assumes a constant angular velocity
 	    Vector3f angVelF  = FAngV.SavitzkyGolaySmooth8();
-        float    angVelFL = angVelF.Length();
             
-        if (angVelFL > 0.001f)
-        {
-            Vector3f    rotAxisP      = angVelF / angVelFL;  
-            float       halfRotAngleP = angVelFL * pdt * 0.5f;
-            float       sinaHRAP      = sin(halfRotAngleP);
-		    Quatf       deltaQP(rotAxisP.x*sinaHRAP, rotAxisP.y*sinaHRAP,
-                                rotAxisP.z*sinaHRAP, cos(halfRotAngleP));
-            qP = QUncorrected * deltaQP;
-        }
+        if (angVelF.LengthSq() > 0.001f * 0.001f)
+            qP = QUncorrected * Quatf::FromRotationVector(angVelF * pdt);
 #else
 		// This method estimates angular acceleration, conservatively
 		OVR_ASSERT(pdt >= 0);
         int       predictionStages = (int)(pdt / PredictionTimeIncrement + 0.5f);
-        Quatd     qpd        = Quatd(Q.x,Q.y,Q.z,Q.w);
+        Quatd     qpd        = Quatd(Q);
         Vector3f  aa         = FAngV.SavitzkyGolayDerivative12();
-        Vector3d  aad        = Vector3d(aa.x,aa.y,aa.z);
+        Vector3d  aad        = Vector3d(aa);
         Vector3f  angVelF    = FAngV.SavitzkyGolaySmooth8();
-        Vector3d  avkd       = Vector3d(angVelF.x,angVelF.y,angVelF.z);
-		Vector3d  rotAxisd   = Vector3d(0,1,0);
+        Vector3d  avkd       = Vector3d(angVelF);
         for (int i = 0; i < predictionStages; i++)
         {
-            double   angVelLengthd = avkd.Length();
-			if (angVelLengthd > 0)
-                rotAxisd = avkd / angVelLengthd;
-            double   halfRotAngled = angVelLengthd * PredictionTimeIncrement * 0.5;
-            double   sinHRAd       = sin(halfRotAngled);
-            Quatd    deltaQd       = Quatd(rotAxisd.x*sinHRAd, rotAxisd.y*sinHRAd, rotAxisd.z*sinHRAd,
-                                           cos(halfRotAngled));
-            qpd = qpd * deltaQd;
+            qpd = qpd * Quatd::FromRotationVector(avkd * PredictionTimeIncrement);
             // Update angular velocity by using the angular acceleration estimate
             avkd += aad;
         }
-        qP = Quatf((float)qpd.x,(float)qpd.y,(float)qpd.z,(float)qpd.w);
+        qP = Quatf(qpd);
 #endif
 	}
+    OVR_FUSION_STAGE_END(FusionStage_Prediction);
     return qP;
 }    
 
 
+//-------------------------------------------------------------------------------------
+// ***** Stage profiling
+
+const char* SensorFusion::GetStageName(FusionStage stage)
+{
+    static const char* names[FusionStage_Count] =
+    {
+        "Input", "FilterInsert", "GyroIntegration", "TiltCorrection",
+        "MagReference", "YawCorrection", "Prediction"
+    };
+    OVR_ASSERT(stage >= 0 && stage < FusionStage_Count);
+    return names[stage];
+}
+
+#if OVR_SENSORFUSION_PROFILE
+
+void SensorFusion::GetStageStats(FusionStage stage, StageStats* stats) const
+{
+    OVR_ASSERT(stage >= 0 && stage < FusionStage_Count);
+    *stats = StageProfile[stage];
+}
+
+void SensorFusion::ResetStageStats()
+{
+    memset(StageProfile, 0, sizeof(StageProfile));
+}
+
+UInt64 SensorFusion::recordStage(FusionStage stage, UInt64 start)
+{
+    UInt64      now    = Timer::GetCycleCount();
+    UInt64      cycles = now - start;
+    StageStats& stats  = StageProfile[stage];
+
+    // Bucket index is floor(log2(cycles)).
+    int bucket = 0;
+#if defined(OVR_CC_GNU)
+    if (cycles)
+        bucket = 63 - __builtin_clzll(cycles);
+#else
+    for (UInt64 c = cycles >> 1; c; c >>= 1)
+        bucket++;
+#endif
+    if (bucket >= StageHistogramBuckets)
+        bucket = StageHistogramBuckets - 1;
+
+    stats.Calls++;
+    stats.TotalCycles += cycles;
+    stats.Histogram[bucket]++;
+    return now;
+}
+
+#endif // OVR_SENSORFUSION_PROFILE
+
+
 Vector3f SensorFusion::GetCalibratedMagValue(const Vector3f& rawMag) const
 {
     Vector3f mag = rawMag;
@@ -391,8 +742,9 @@ void SensorFusion::SetMagReference(const Quatf& q, const Vector3f& rawMag)
 {
     if (MagNumReferences < MagMaxReferences)
     {
-        MagRefTableQ[MagNumReferences] = q;
-        MagRefTableM[MagNumReferences] = rawMag; //FRawMag.Mean();
+        MagReference ref;
+        ref.Q = q;
+        ref.M = rawMag; //FRawMag.Mean();
 
 		//LogText("Inserting reference %d\n",MagNumReferences);
         
@@ -402,15 +754,40 @@ void SensorFusion::SetMagReference(const Quatf& q, const Vector3f& rawMag)
         float pitch, roll, yaw;
 		Quatf q2 = q;
         q2.GetEulerAngles<Axis_X, Axis_Z, Axis_Y>(&pitch, &roll, &yaw);
-        MagRefTableYaw[MagNumReferences] = yaw;
+        ref.Yaw   = yaw;
 		MagRefYaw = yaw;
 
+        MagRefTable.PushBack(ref);
         MagNumReferences++;
 
         MagHasNearbyReference = true;
     }
 }
 
+void SensorFusion::ClearMagReferences()
+{
+    MagRefTable.Clear();
+    MagNumReferences      = 0;
+    MagHasNearbyReference = false;
+}
+
+int SensorFusion::findNearestMagReference(const Quatf& q) const
+{
+    float bestDistSq = MagRefDistance * MagRefDistance;
+    int   bestNdx    = -1;
+
+    for (int i = 0; i < MagNumReferences; i++)
+    {
+        float distSq = q.DistanceSq(MagRefTable[i].Q);
+        if (distSq < bestDistSq)
+        {
+            bestNdx    = i;
+            bestDistSq = distSq;
+        }
+    }
+    return bestNdx;
+}
+
 
 SensorFusion::BodyFrameHandler::~BodyFrameHandler()
 {
@@ -19,6 +19,13 @@ otherwise accompanies this software in either electronic or hard copy form.
 
 #include "OVR_Device.h"
 #include "OVR_SensorFilter.h"
+#include "Kernel/OVR_Array.h"
+
+// Define OVR_SENSORFUSION_PROFILE to 1 when building LibOVR to time each stage of
+// message handling and prediction; see SensorFusion::GetStageStats.
+#ifndef OVR_SENSORFUSION_PROFILE
+#define OVR_SENSORFUSION_PROFILE 0
+#endif
 
 namespace OVR {
 
@@ -39,10 +46,88 @@ class SensorFusion : public NewOverrideBase
 {
     enum
     {
-        MagMaxReferences = 80
+        MagMaxReferences = 80,
+        FilterCapacity   = 32   // Largest supported filter window
     };
 
+    typedef SensorFilterBase<float, FilterCapacity>   FusionFilter;
+    // For the filters whose Median is used when TuningParams::UseMedianFilter is set.
+    typedef SensorFilterMedian<float, FilterCapacity> FusionMedianFilter;
+
 public:
+    // Thresholds and filter window sizes used by the tilt and yaw correction logic.
+    // The defaults are hand-picked for the Rift DK sensor at 1000Hz; they are exposed
+    // mostly so that offline tuning tools can explore alternatives.
+    struct TuningParams
+    {
+        // Filter window sizes (samples) for raw mag, world accel and angular velocity,
+        // at most 32. AngVelFilterSize must be at least 8 because prediction uses
+        // SavitzkyGolaySmooth8.
+        int     MagFilterSize;
+        int     AccelFilterSize;
+        int     AngVelFilterSize;
+        // Use the window median rather than the mean of accel and mag readings for
+        // tilt and yaw error estimates; more robust to spikes.
+        bool    UseMedianFilter;
+
+        // Tilt correction
+        float   GravityEpsilon;     // Max deviation of |accel| from 1g to count as at rest
+        float   AngVelEpsilon;      // Max rotation rate (rad/s) to count as at rest
+        int     TiltPeriod;         // Required time steps of stability
+        float   MaxTiltError;       // Tilt error (rad) above which a correction is recorded
+        float   MinTiltError;       // Tilt error (rad) below which correction stops
+        float   TiltSnapAngle;      // Tilt errors above this are corrected at once ...
+        float   TiltSnapTime;       // ... if they are seen within this many seconds of startup
+                                    //     or of RestoreState
+        int     TiltCorrectionPeriod; // Samples between applying the accumulated tilt steps
+
+        // Yaw correction
+        float   MaxAngVelLength;    // Max rotation rate (rad/s) for usable mag readings
+        int     MagWindow;          // Required time steps below MaxAngVelLength
+        float   YawErrorMax;        // Yaw error (rad) that triggers correction
+        float   YawErrorMin;        // Yaw error (rad) at which correction stops
+        int     YawErrorCountLimit; // Time steps of large error before correcting
+        float   YawRotationStep;    // Correction applied per time step (rad)
+        float   YawStartTime;       // Seconds before yaw correction may run
+        float   MagRefStartTime;    // Seconds before mag reference points may be set
+        float   MagRefMaxTilt;      // No reference points are set above this tilt error
+        int     YawCorrectionPeriod;  // Samples between mag reference and yaw updates
+
+        TuningParams()
+          : MagFilterSize(10), AccelFilterSize(20), AngVelFilterSize(20), UseMedianFilter(false),
+            GravityEpsilon(0.4f), AngVelEpsilon(0.1f), TiltPeriod(50),
+            MaxTiltError(0.05f), MinTiltError(0.01f), TiltSnapAngle(0.4f), TiltSnapTime(8.0f),
+            TiltCorrectionPeriod(10),
+            MaxAngVelLength(3.0f), MagWindow(5), YawErrorMax(0.1f), YawErrorMin(0.01f),
+            YawErrorCountLimit(50), YawRotationStep(0.00002f), YawStartTime(2.0f),
+            MagRefStartTime(10.0f), MagRefMaxTilt(0.2f), YawCorrectionPeriod(10)
+        { }
+    };
+
+    // Stages of sample processing timed when OVR_SENSORFUSION_PROFILE is enabled.
+    enum FusionStage
+    {
+        FusionStage_Input,          // Reading and calibrating the sample
+        FusionStage_FilterInsert,   // Adding to the filter histories
+        FusionStage_GyroIntegration,
+        FusionStage_TiltCorrection,
+        FusionStage_MagReference,   // Finding or creating mag reference points
+        FusionStage_YawCorrection,
+        FusionStage_Prediction,     // GetPredictedOrientation
+        FusionStage_Count
+    };
+
+    enum { StageHistogramBuckets = 32 };
+
+    struct StageStats
+    {
+        UInt32  Calls;
+        UInt64  TotalCycles;
+        // Histogram[i] counts stage executions that took [2^i, 2^(i+1)) cycles
+        // (bucket 0 also holds zero-length spans, the last bucket everything longer).
+        UInt32  Histogram[StageHistogramBuckets];
+    };
+
     SensorFusion(SensorDevice* sensor = 0);
     ~SensorFusion();
     
@@ -66,6 +151,12 @@ public:
     // Yaw correction is currently working (forcing a corrective yaw rotation)
     bool        IsYawCorrectionInProgress() const       { return YawCorrectionInProgress;}
 
+    // When enabled, the orientation is integrated and corrected in double precision
+    // and only rounded to float for output. This keeps rounding error from building up
+    // in long-running sessions at a small per-sample cost. Off by default.
+    void        SetDoublePrecisionEnabled(bool enable);
+    bool        IsDoublePrecisionEnabled() const        { return EnableDoublePrecision; }
+
     // Store the calibration matrix for the magnetometer
     void        SetMagCalibration(const Matrix4f& m)
     {
@@ -80,8 +171,9 @@ public:
     void        ClearMagCalibration()            { MagCalibrated = false; }
 
 	// These refer to reference points that associate mag readings with orientations
-	void        ClearMagReferences()             { MagNumReferences = 0; }
+	void        ClearMagReferences();
     void        SetMagRefDistance(const float d) { MagRefDistance = d; }
+    int         GetMagNumReferences() const      { return MagNumReferences; }
 
     // Notifies SensorFusion object about a new BodyFrame message from a sensor.
     // Should be called by user if not attaching to a sensor.
@@ -91,6 +183,26 @@ public:
         handleMessage(msg);
     }
 
+    // Fuses an array of BodyFrame messages in order, storing the orientation reached
+    // after each one in orientations[i] (which can be null if only the final state is
+    // needed). Meant for offline processing of recorded traces on an instance that is
+    // not attached to a sensor; no locking or message dispatch takes place.
+    void        FuseBatch(const MessageBodyFrame* msgs, UPInt count, Quatf* orientations = 0);
+
+    // Checkpointing of the fused state (orientation, mag reference table, mag and
+    // angular velocity filter histories and mag calibration) so that a reconnected or
+    // re-created sensor can resume without waiting for yaw correction to converge
+    // again. The session time and tilt error are stored too, so the start-up delays of
+    // yaw correction don't apply again. The headset may have moved while unplugged, so
+    // the restored tilt error is not corrected for; it only gates mag references until
+    // the next estimate replaces it, which may snap as at startup.
+    // SaveState returns the number of bytes required and writes them only if bufferSize
+    // is large enough. RestoreState should be called after AttachToSensor, since
+    // attaching resets the state; it fails if the data is not a valid checkpoint.
+    // The format uses native byte order and is not meant for exchange between platforms.
+    UPInt       SaveState(void* buffer, UPInt bufferSize) const;
+    bool        RestoreState(const void* buffer, UPInt size);
+
     // Obtain the current accumulated orientation.
     Quatf       GetOrientation() const
     {
@@ -176,18 +288,53 @@ public:
 	void		SetPredictionEnabled(bool enable = true)    { EnablePrediction = enable; }    
 	bool		IsPredictionEnabled()                       { return EnablePrediction; }
 
+#if OVR_SENSORFUSION_PROFILE
+    // Per-stage timing in Timer::GetCycleCount units. Stats are updated without locking
+    // by the thread running each stage, so a read concurrent with message handling may
+    // be slightly inconsistent.
+    void        GetStageStats(FusionStage stage, StageStats* stats) const;
+    void        ResetStageStats();
+#endif
+    static const char* GetStageName(FusionStage stage);
+
+    // Correction thresholds and filter sizes. Changing filter sizes discards
+    // the filter history.
+    const TuningParams& GetTuning() const               { return Tuning; }
+    void        SetTuning(const TuningParams& tuning);
+
 private:
     SensorFusion* getThis()  { return this; }
 
     // Internal handler for messages; bypasses error checking.
     void handleMessage(const MessageBodyFrame& msg);
 
+    // Applies a world-frame correction rotation to the orientation.
+    void        applyCorrection(const Quatf& dq);
+
+#if OVR_SENSORFUSION_PROFILE
+    // Records the time since start for a stage and returns the current cycle count.
+    UInt64      recordStage(FusionStage stage, UInt64 start);
+#endif
+
     // Set the magnetometer's reference orientation for use in yaw correction
     // The supplied mag is an uncalibrated value
     void        SetMagReference(const Quatf& q, const Vector3f& rawMag);
     // Default to current HMD orientation
     void        SetMagReference()                { SetMagReference(Q, RawMag); }
 
+    // Returns the index of the stored reference closest to q, considering only
+    // references within MagRefDistance; -1 if there is none.
+    int         findNearestMagReference(const Quatf& q) const;
+
+    // Reference point associating a raw mag reading with the orientation at which
+    // it was taken.
+    struct MagReference
+    {
+        Quatf    Q;
+        Vector3f M;
+        float    Yaw;
+    };
+
 	class BodyFrameHandler : public MessageHandler
     {
         SensorFusion* pFusion;
@@ -201,12 +348,15 @@ private:
 
     Quatf             Q;
 	Quatf			  QUncorrected;
+    bool              EnableDoublePrecision;
+    Quatd             QAccum;           // Master copy of Q if EnableDoublePrecision
     Vector3f          A;    
     Vector3f          AngV;
     Vector3f          CalMag;
     Vector3f          RawMag;
     unsigned int      Stage;
 	float             RunningTime;
+    float             TiltSnapClock;    // Seconds since startup or RestoreState
 	float             DeltaT;
     BodyFrameHandler  Handler;
     MessageHandler*   pDelegate;
@@ -218,13 +368,18 @@ private:
     float             PredictionDT;
 	float             PredictionTimeIncrement;
 
-    SensorFilter      FRawMag;
-    SensorFilter      FAccW;
-    SensorFilter      FAngV;
+    TuningParams      Tuning;   // Declared before the filters it sizes
+    FusionMedianFilter FRawMag;
+    FusionMedianFilter FAccW;
+    FusionFilter      FAngV;
 
     int               TiltCondCount;
     float             TiltErrorAngle;
     Vector3f          TiltErrorAxis;
+    float             TiltStepFraction;     // Error fraction removed by deferred steps
+    int               TiltDeferredSteps;
+    bool              TiltErrorStale;       // Restored error, not to be corrected for
+    int               YawDeferredSteps;
 
     bool              EnableYawCorrection;
     Matrix4f          MagCalibrationMatrix;
@@ -235,15 +390,19 @@ private:
     Vector3f          MagRefM;
     float             MagRefYaw;
     bool              MagHasNearbyReference;
-    Quatf             MagRefTableQ[MagMaxReferences];
-    Vector3f          MagRefTableM[MagMaxReferences];
-    float             MagRefTableYaw[MagMaxReferences];
+    // References are at least MagRefDistance apart, so at the default distance the
+    // table stays small and a scan of it is as fast as any index.
+    ArrayPOD<MagReference> MagRefTable;
     int               MagNumReferences;
     float             YawErrorAngle;
     int               YawErrorCount;
     bool              YawCorrectionInProgress;
 	bool			  YawCorrectionActivated;
 
+#if OVR_SENSORFUSION_PROFILE
+    StageStats        StageProfile[FusionStage_Count];
+#endif
+
 };
 
 
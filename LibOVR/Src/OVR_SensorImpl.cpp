@@ -485,7 +485,7 @@ SensorDeviceImpl::SensorDeviceImpl(SensorDeviceCreateDesc* createDesc)
     : OVR::HIDDeviceImpl<OVR::SensorDevice>(createDesc, 0),
       Coordinates(SensorDevice::Coord_Sensor),
       HWCoordinates(SensorDevice::Coord_HMD), // HW reports HMD coordinates by default.
-      NextKeepAliveTicks(0),
+      KeepAliveCallId(0),
       MaxValidRange(SensorRangeImpl::GetMaxSensorRange())
 {
     SequenceValid  = false;
@@ -542,19 +542,28 @@ void SensorDeviceImpl::openDevice()
     setCoordinateFrame(Coordinates);
     setReportRate(Sensor_DefaultReportRate);
 
-    // Set Keep-alive at 10 seconds.
-    SensorKeepAliveImpl skeepAlive(10 * 1000);
-    GetInternalDevice()->SetFeatureReport(skeepAlive.Buffer, SensorKeepAliveImpl::PacketSize);
+    // Set Keep-alive at 10 seconds, and renew it every 3 seconds.
+    sendKeepAlive();
+    if (!KeepAliveCallId)
+    {
+        KeepAliveCallId = GetManagerImpl()->GetThreadQueue()->
+            PushCallEvery(Timer::MksPerSecond * 3, this, &SensorDeviceImpl::sendKeepAlive);
+    }
 }
 
 void SensorDeviceImpl::closeDeviceOnError()
 {
     LogText("OVR::SensorDevice - Lost connection to '%s'\n", getHIDDesc()->Path.ToCStr());
-    NextKeepAliveTicks = 0;
 }
 
 void SensorDeviceImpl::Shutdown()
 {   
+    if (KeepAliveCallId)
+    {
+        GetManagerImpl()->GetThreadQueue()->CancelScheduledCall(KeepAliveCallId);
+        KeepAliveCallId = 0;
+    }
+
     HIDDeviceImpl<OVR::SensorDevice>::Shutdown();
 
     LogText("OVR::SensorDevice - Closed '%s'\n", getHIDDesc()->Path.ToCStr());
@@ -577,39 +586,40 @@ void SensorDeviceImpl::OnInputReport(UByte* pData, UInt32 length)
     }
 }
 
-UInt64 SensorDeviceImpl::OnTicks(UInt64 ticksMks)
+// Scheduled on the device manager thread, so it can talk to the device directly.
+Void SensorDeviceImpl::sendKeepAlive()
 {
-
-    if (ticksMks >= NextKeepAliveTicks)
-    {
-        // Use 3-seconds keep alive by default.
-        UInt64 keepAliveDelta = Timer::MksPerSecond * 3;
-
-        // Set Keep-alive at 10 seconds.
-        SensorKeepAliveImpl skeepAlive(10 * 1000);
-        // OnTicks is called from background thread so we don't need to add this to the command queue.
-        GetInternalDevice()->SetFeatureReport(skeepAlive.Buffer, SensorKeepAliveImpl::PacketSize);
-
-		// Emit keep-alive every few seconds.
-        NextKeepAliveTicks = ticksMks + keepAliveDelta;
-    }
-    return NextKeepAliveTicks - ticksMks;
+    SensorKeepAliveImpl skeepAlive(10 * 1000);
+    GetInternalDevice()->SetFeatureReport(skeepAlive.Buffer, SensorKeepAliveImpl::PacketSize);
+    return 0;
 }
 
+// Settings changes go through the high priority lane, so that they don't wait behind
+// enumeration. Queued changes of the same setting are coalesced, keyed by the
+// device address plus one of these.
+enum
+{
+    Coalesce_Range           = 1,
+    Coalesce_CoordinateFrame = 2,
+    Coalesce_ReportRate      = 3
+};
+
 bool SensorDeviceImpl::SetRange(const SensorRange& range, bool waitFlag)
 {
+    typedef ThreadCommandMF1<SensorDeviceImpl, bool, const SensorRange&> SetRangeCommand;
+
     bool                 result = 0;
     ThreadCommandQueue * threadQueue = GetManagerImpl()->GetThreadQueue();
 
     if (!waitFlag)
     {
-        return threadQueue->PushCall(this, &SensorDeviceImpl::setRange, range);
+        return threadQueue->PushCommand(SetRangeCommand(this, &SensorDeviceImpl::setRange, 0, range, false),
+                                        ThreadCommandQueue::Priority_High, (UPInt)this + Coalesce_Range);
     }
     
-    if (!threadQueue->PushCallAndWaitResult(this, 
-                                            &SensorDeviceImpl::setRange,
-                                            &result, 
-                                            range))
+    // Not coalesced, since the caller needs its own result.
+    if (!threadQueue->PushCommand(SetRangeCommand(this, &SensorDeviceImpl::setRange, &result, range, true),
+                                  ThreadCommandQueue::Priority_High))
     {
         return false;
     }
@@ -641,7 +651,9 @@ void SensorDeviceImpl::SetCoordinateFrame(CoordinateFrame coordframe)
 { 
     // Push call with wait.
     GetManagerImpl()->GetThreadQueue()->
-        PushCall(this, &SensorDeviceImpl::setCoordinateFrame, coordframe, true);
+        PushCommand(ThreadCommandMF1<SensorDeviceImpl, Void, CoordinateFrame>(
+                        this, &SensorDeviceImpl::setCoordinateFrame, 0, coordframe, true),
+                    ThreadCommandQueue::Priority_High, (UPInt)this + Coalesce_CoordinateFrame);
 }
 
 SensorDevice::CoordinateFrame SensorDeviceImpl::GetCoordinateFrame() const
@@ -683,7 +695,9 @@ void SensorDeviceImpl::SetReportRate(unsigned rateHz)
 { 
     // Push call with wait.
     GetManagerImpl()->GetThreadQueue()->
-        PushCall(this, &SensorDeviceImpl::setReportRate, rateHz, true);
+        PushCommand(ThreadCommandMF1<SensorDeviceImpl, Void, unsigned>(
+                        this, &SensorDeviceImpl::setReportRate, 0, rateHz, true),
+                    ThreadCommandQueue::Priority_High, (UPInt)this + Coalesce_ReportRate);
 }
 
 unsigned SensorDeviceImpl::GetReportRate() const
@@ -133,7 +133,6 @@ public:
 
     // HIDDevice::Notifier interface.
     virtual void OnInputReport(UByte* pData, UInt32 length);
-    virtual UInt64 OnTicks(UInt64 ticksMks);
 
     // HMD-Mounted sensor has a different coordinate frame.
     virtual void SetCoordinateFrame(CoordinateFrame coordframe);    
@@ -168,6 +167,9 @@ protected:
 
     Void    setReportRate(unsigned rateHz);
 
+    // Renews the sensor's keep-alive; runs periodically on the device manager thread.
+    Void    sendKeepAlive();
+
     // Called for decoded messages
     void        onTrackerMessage(TrackerMessage* message);
 
@@ -185,7 +187,8 @@ protected:
     // so we track its state.
     CoordinateFrame Coordinates;
     CoordinateFrame HWCoordinates;
-    UInt64      NextKeepAliveTicks;
+    // Scheduled sendKeepAlive call, 0 if none.
+    UInt32      KeepAliveCallId;
 
     bool        SequenceValid;
     SInt16      LastTimestamp;
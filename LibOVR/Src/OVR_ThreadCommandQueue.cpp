@@ -14,152 +14,239 @@ otherwise accompanies this software in either electronic or hard copy form.
 ************************************************************************************/
 
 #include "OVR_ThreadCommandQueue.h"
+#include "Kernel/OVR_Array.h"
 
 namespace OVR {
 
 
 //------------------------------------------------------------------------
-// ***** CircularBuffer
+// ***** CommandRing
 
-// CircularBuffer is a FIFO buffer implemented in a single block of memory,
-// which allows writing and reading variable-size data chucks. Write fails
-// if buffer is full.
+// CommandRing is a bounded FIFO of fixed-size slots that any number of producers
+// can write to without locking while a single consumer reads from it.
+// Each slot carries a sequence number telling whose turn it is: a slot at
+// position pos is free for the producer holding pos when Sequence == pos, and
+// holds a published command for the consumer when Sequence == pos + 1.
+// Producers claim positions by CAS on EnqueuePos; the consumer owns DequeuePos.
+// Commands too large for a slot are copied to the heap and the slot holds a pointer.
 
-class CircularBuffer
+class CommandRing
 {
+public:
     enum {
-        AlignSize = 16,
-        AlignMask = AlignSize - 1
+        SlotCount = 64,
+        SlotMask  = SlotCount - 1,
+        SlotSize  = 128,
+        DataSize  = SlotSize - 2 * sizeof(UPInt)
     };
 
-    UByte*  pBuffer;
-    UPInt   Size;
-    UPInt   Tail;   // Byte offset of next item to be popped.
-    UPInt   Head;   // Byte offset of where next push will take place.
-    UPInt   End;    // When Head < Tail, this is used instead of Size.    
-
-    inline UPInt roundUpSize(UPInt size)
-    { return (size + AlignMask) & ~(UPInt)AlignMask; }
+    // Set in EnqueuePos together with the last accepted (exit) command.
+    static const UPInt ClosedFlag = ((UPInt)1) << (sizeof(UPInt) * 8 - 1);
 
-public:
+    enum PushResult
+    {
+        Push_Ok,
+        Push_Full,
+        Push_Closed
+    };
 
-    CircularBuffer(UPInt size)
-        : Size(size), Tail(0), Head(0), End(0)
+    CommandRing()
+        : EnqueuePos(0), DequeuePos(0)
     {
-        pBuffer = (UByte*)OVR_ALLOC_ALIGNED(roundUpSize(size), AlignSize);
+        OVR_COMPILER_ASSERT(sizeof(Slot) == SlotSize);
+        pSlots = (Slot*)OVR_ALLOC_ALIGNED(sizeof(Slot) * SlotCount, 64);
+        for (UPInt i = 0; i < SlotCount; i++)
+            Construct<Slot>(pSlots + i)->Sequence.Store_Release(i);
     }
-    ~CircularBuffer()
+    ~CommandRing()
     {
         // For ThreadCommands, we must consume everything before shutdown.
         OVR_ASSERT(IsEmpty());
-        OVR_FREE_ALIGNED(pBuffer);
+        OVR_FREE_ALIGNED(pSlots);
     }
 
-    bool    IsEmpty() const { return (Head == Tail); }
+    // Only meaningful on the consumer thread.
+    bool        IsEmpty() const
+    { return pSlots[DequeuePos & SlotMask].Sequence.Load_Acquire() != DequeuePos + 1; }
 
-    // Allocates a state block of specified size and advances pointers,
-    // returning 0 if buffer is full.
-    UByte*  Write(UPInt size);
+    bool        IsFull() const
+    {
+        UPInt pos = EnqueuePos.Load_Acquire() & ~ClosedFlag;
+        return (SPInt)(pSlots[pos & SlotMask].Sequence.Load_Acquire() - pos) < 0;
+    }
 
-    // Returns a pointer to next available data block; 0 if none available.
-    UByte*  ReadBegin()
-    { return (Head != Tail) ? (pBuffer + Tail) : 0; }
-    // Consumes data of specified size; this must match size passed to Write.
-    void    ReadEnd(UPInt size);
+    // Returns 'true' if every claimed slot has been popped, including slots whose
+    // producers haven't published yet. Only meaningful on the consumer thread.
+    bool        IsDrained() const
+    { return (EnqueuePos.Load_Acquire() & ~ClosedFlag) == DequeuePos; }
+
+    // Copies the command into the next free slot. With 'close' set, no further
+    // pushes are accepted once this one succeeds. If completeEvent is not null it
+    // is attached to the copy before the copy becomes visible to the consumer.
+    PushResult  Push(const ThreadCommand& command, bool close,
+                     CompletionEvent* completeEvent, UPInt coalesceKey);
+    // Rejects all further pushes.
+    void        Close();
+
+    // Returns the command at the head of the ring, or 0 if the ring is empty.
+    // The command stays in its slot until PopEnd.
+    ThreadCommand* PopBegin();
+    // Destroys the command returned by PopBegin and frees its slot.
+    void        PopEnd();
+
+private:
+    struct Slot
+    {
+        AtomicInt<UPInt> Sequence;
+        UPInt            External;  // Data holds a pointer to a heap copy.
+        union {
+            UByte        Data[DataSize];
+            UPInt        Align;
+        };
+    };
+
+    Slot*            pSlots;
+    // Producer and consumer positions are kept on separate cache lines.
+    UByte            Pad0[64 - sizeof(Slot*)];
+    AtomicInt<UPInt> EnqueuePos;
+    UByte            Pad1[64 - sizeof(AtomicInt<UPInt>)];
+    UPInt            DequeuePos;
 };
 
 
-// Allocates a state block of specified size and advances pointers,
-// returning 0 if buffer is full.
-UByte* CircularBuffer::Write(UPInt size)
+CommandRing::PushResult CommandRing::Push(const ThreadCommand& command, bool close,
+                                          CompletionEvent* completeEvent, UPInt coalesceKey)
 {
-    UByte* p = 0;
+    UPInt  pos = EnqueuePos.Load_Acquire();
+    Slot*  slot;
 
-    size = roundUpSize(size);
-    // Since this is circular buffer, always allow at least one item.
-    OVR_ASSERT(size < Size/2);
-
-    if (Head >= Tail)
+    while(1)
     {
-        OVR_ASSERT(End == 0);
-        
-        if (size <= (Size - Head))
+        if (pos & ClosedFlag)
+            return Push_Closed;
+
+        slot = pSlots + (pos & SlotMask);
+        SPInt diff = (SPInt)(slot->Sequence.Load_Acquire() - pos);
+
+        if (diff == 0)
         {
-            p    = pBuffer + Head;
-            Head += size;
+            UPInt newPos = close ? ((pos + 1) | ClosedFlag) : (pos + 1);
+            if (EnqueuePos.CompareAndSet_Sync(pos, newPos))
+                break;
         }
-        else if (size < Tail)
+        else if (diff < 0)
         {
-            p    = pBuffer;
-            End  = Head;
-            Head = size;
-            OVR_ASSERT(Head != Tail);
+            // The consumer hasn't freed this slot since the last lap.
+            return Push_Full;
         }
+        pos = EnqueuePos.Load_Acquire();
+    }
+
+    ThreadCommand* c;
+    if (command.GetSize() <= DataSize)
+    {
+        slot->External = 0;
+        c = command.CopyConstruct(slot->Data);
     }
     else
     {
-        OVR_ASSERT(End != 0);
-
-        if ((Tail - Head) > size)
-        {
-            p    = pBuffer + Head;
-            Head += size;
-            OVR_ASSERT(Head != Tail);
-        }
+        void* p = OVR_ALLOC(command.GetSize());
+        slot->External = 1;
+        *(void**)slot->Data = p;
+        c = command.CopyConstruct(p);
     }
+    c->pEvent      = completeEvent;
+    c->CoalesceKey = coalesceKey;
 
-    return p;
+    // Full barrier, so that the caller's following check of the consumer state
+    // can't be ordered before the command is visible.
+    slot->Sequence.Exchange_Sync(pos + 1);
+    return Push_Ok;
 }
 
-void CircularBuffer::ReadEnd(UPInt size)
+void CommandRing::Close()
 {
-    OVR_ASSERT(Head != Tail);
-    size = roundUpSize(size);
-    
-    Tail += size;        
-    if (Tail == End)
-    {
-        Tail = End = 0;
-    }
-    else if (Tail == Head)
-    {        
-        OVR_ASSERT(End == 0);
-        Tail = Head = 0;
-    }
+    UPInt pos = EnqueuePos.Load_Acquire();
+    while(!(pos & ClosedFlag) && !EnqueuePos.CompareAndSet_Sync(pos, pos | ClosedFlag))
+        pos = EnqueuePos.Load_Acquire();
 }
 
-
-//-------------------------------------------------------------------------------------
-// ***** ThreadCommand
-
-ThreadCommand::PopBuffer::~PopBuffer()
+ThreadCommand* CommandRing::PopBegin()
 {
-    if (Size)
-        Destruct<ThreadCommand>(toCommand());
+    Slot* slot = pSlots + (DequeuePos & SlotMask);
+    if (slot->Sequence.Load_Acquire() != DequeuePos + 1)
+        return 0;
+    return (ThreadCommand*)(slot->External ? *(void**)slot->Data : slot->Data);
 }
 
-void ThreadCommand::PopBuffer::InitFromBuffer(void* data)
+void CommandRing::PopEnd()
 {
-    ThreadCommand* cmd = (ThreadCommand*)data;
-    OVR_ASSERT(cmd->Size <= MaxSize);
+    Slot* slot = pSlots + (DequeuePos & SlotMask);
+    OVR_ASSERT(slot->Sequence.Load_Acquire() == DequeuePos + 1);
 
-    if (Size)
-        Destruct<ThreadCommand>(toCommand());    
-    Size = cmd->Size;    
-    memcpy(Buffer, (void*)cmd, Size);
+    if (slot->External)
+    {
+        void* p = *(void**)slot->Data;
+        Destruct<ThreadCommand>((ThreadCommand*)p);
+        OVR_FREE(p);
+    }
+    else
+    {
+        Destruct<ThreadCommand>((ThreadCommand*)slot->Data);
+    }
+
+    // Full barrier, so that the check for blocked producers that follows sees
+    // any producer that found the ring full before this slot was freed.
+    slot->Sequence.Exchange_Sync(DequeuePos + SlotCount);
+    DequeuePos++;
 }
 
+
+//-------------------------------------------------------------------------------------
+// ***** ThreadCommand
+
 void ThreadCommand::PopBuffer::Execute()
 {
-    ThreadCommand* command = toCommand();
-    OVR_ASSERT(command);
-    command->Execute();
+    OVR_ASSERT(pCommand);
+    pCommand->Execute();
     if (NeedsWait())
-        GetEvent()->PulseEvent();
+        GetEvent()->Signal();
+    release();
 }
 
 //-------------------------------------------------------------------------------------
 
+// Commands go through CommandRing without taking QueueLock. The lock is only used
+// on the slow paths: parking producers while the ring is
+// full, and the consumer wake-up notifications.
+//
+// Wake-up: when PopCommand finds the ring empty it calls OnPopEmpty_Locked and
+// sets ConsumerIdle, then checks the ring once more. A producer that clears
+// ConsumerIdle after publishing calls OnPushNonEmpty_Locked. Both sides have a
+// full barrier between their write and their read, so either the consumer sees
+// the new command or the producer sees the idle flag.
+//
+// Each priority lane has its own ring and list of blocked producers. The exit
+// command goes through the normal lane, after the high lane has been closed; it is
+// only popped once the high lane is drained.
+//
+// Coalescing: CoalescePending counts the queued commands of each key, under
+// QueueLock. A keyed command popped while the count says a later one is still
+// queued is dropped. Keys are per-device settings and only a few are pending at
+// once, so the counts are kept in a small array. A dropped waiting command marks
+// its CommandCompletion as superseded before signaling it, so that PushCommand can
+// report that the command never ran.
+//
+// Scheduled calls live in the Timers min-heap, which only the consumer thread
+// touches. Other threads add and cancel them by pushing internal commands.
+
+struct CommandCompletion : public CompletionEvent
+{
+    bool    Superseded;
+
+    CommandCompletion() : Superseded(false) { }
+};
+
 class ThreadCommandQueueImpl : public NewOverrideBase
 {
     typedef ThreadCommand::NotifyEvent NotifyEvent;
@@ -168,15 +255,100 @@ class ThreadCommandQueueImpl : public NewOverrideBase
 public:
 
     ThreadCommandQueueImpl(ThreadCommandQueue* queue)
-        : pQueue(queue), CommandBuffer(2048),
-          ExitEnqueued(false), ExitProcessed(false)
+        : pQueue(queue), QueueLock(Lock::ShortSectionSpinCount),
+          ExitEnqueued(false), ExitProcessed(false), ConsumerIdle(0),
+          // Spinning can only help if the consumer runs on another core.
+          CompletionSpinCount((Thread::GetCPUCount() > 1) ? 500 : 0),
+          PoppedLane(0), NextTimerId(0), ConsumerThreadId(0), TimerPopped(false)
     {
     }
     ~ThreadCommandQueueImpl();
 
 
-    bool PushCommand(const ThreadCommand& command);
+    bool PushCommand(const ThreadCommand& command,
+                     ThreadCommandQueue::CommandPriority priority = ThreadCommandQueue::Priority_Normal,
+                     UPInt coalesceKey = 0);
     bool PopCommand(ThreadCommand::PopBuffer* popBuffer);
+    // Frees the slot of the command held by popBuffer, once it is done with it.
+    void ReleaseCommand(ThreadCommand::PopBuffer* popBuffer);
+
+
+    UInt32 ScheduleCommand(const ThreadCommand& command, UInt64 ticksMks, UInt64 periodMks);
+    bool   CancelScheduledCall(UInt32 id);
+
+
+    // Number of queued commands with a coalesce key.
+    struct CoalesceCount
+    {
+        UPInt   Key;
+        UPInt   Count;
+    };
+
+    // A call scheduled with ScheduleCommand.
+    struct TimerEntry
+    {
+        UInt64          Deadline;   // Timer::GetTicks() value at which the call is due.
+        UInt64          Period;     // 0 for one-shot calls.
+        UInt32          Id;
+        ThreadCommand*  pCommand;   // Heap copy, owned by the entry.
+
+        // Heap order; ties go to the call scheduled first.
+        bool IsBefore(const TimerEntry& other) const
+        {
+            return (Deadline != other.Deadline) ? (Deadline < other.Deadline)
+                                                : ((SInt32)(Id - other.Id) < 0);
+        }
+    };
+
+    // Used to add a scheduled call from outside the consumer thread.
+    struct AddTimerCommand : public ThreadCommand
+    {
+        ThreadCommandQueueImpl* pImpl;
+        TimerEntry              Entry;
+
+        AddTimerCommand(ThreadCommandQueueImpl* impl, const TimerEntry& entry)
+            : ThreadCommand(sizeof(AddTimerCommand), false), pImpl(impl), Entry(entry) { }
+
+        virtual void Execute() const
+        {
+            pImpl->addTimer(Entry);
+        }
+        virtual ThreadCommand* CopyConstruct(void* p) const
+        { return Construct<AddTimerCommand>(p, *this); }
+    };
+
+    // Used to cancel a scheduled call from outside the consumer thread.
+    struct CancelTimerCommand : public ThreadCommand
+    {
+        ThreadCommandQueueImpl* pImpl;
+        UInt32                  Id;
+        bool*                   pResult;
+
+        CancelTimerCommand(ThreadCommandQueueImpl* impl, UInt32 id, bool* result)
+            : ThreadCommand(sizeof(CancelTimerCommand), true), pImpl(impl), Id(id), pResult(result) { }
+
+        virtual void Execute() const
+        {
+            *pResult = pImpl->cancelTimer(Id);
+        }
+        virtual ThreadCommand* CopyConstruct(void* p) const
+        { return Construct<CancelTimerCommand>(p, *this); }
+    };
+
+    bool        isConsumerThread() const
+    { return ConsumerThreadId && (ConsumerThreadId == GetCurrentThreadId()); }
+
+    static void freeTimerCommand(ThreadCommand* command)
+    {
+        Destruct<ThreadCommand>(command);
+        OVR_FREE(command);
+    }
+
+    // Timer heap operations; consumer thread only.
+    void        addTimer(const TimerEntry& entry);
+    void        removeTimer(UPInt index);
+    void        placeTimer(UPInt index, const TimerEntry& entry);
+    bool        cancelTimer(UInt32 id);
 
 
     // ExitCommand is used by notify us that Thread is shutting down.
@@ -189,7 +361,6 @@ public:
 
         virtual void Execute() const
         {
-            Lock::Locker lock(&pImpl->QueueLock);
             pImpl->ExitProcessed = true;
         }
         virtual ThreadCommand* CopyConstruct(void* p) const 
@@ -223,13 +394,106 @@ public:
         }
     }
 
+    // Wakes the consumer if it went idle; called after every successful push.
+    void        notifyConsumer()
+    {
+        if (ConsumerIdle && ConsumerIdle.Exchange_Sync(0))
+        {
+            Lock::Locker lock(&QueueLock);
+            pQueue->OnPushNonEmpty_Locked();
+        }
+    }
+
+    struct Lane
+    {
+        CommandRing         Commands;
+        List<NotifyEvent>   BlockedProducers;
+        AtomicInt<int>      HasBlockedProducers;
+
+        Lane() : HasBlockedProducers(0) { }
+
+        // Releases the first producer waiting for a free slot; called after every pop.
+        void    releaseBlockedProducer(Lock* queueLock)
+        {
+            if (!HasBlockedProducers)
+                return;
+
+            Lock::Locker lock(queueLock);
+            if (!BlockedProducers.IsEmpty())
+            {
+                NotifyEvent* queueAvailableEvent = BlockedProducers.GetFirst();
+                queueAvailableEvent->RemoveNode();
+                queueAvailableEvent->PulseEvent();
+                // Event is freed later by waiter.
+            }
+            if (BlockedProducers.IsEmpty())
+                HasBlockedProducers = 0;
+        }
+    };
+
+    // Returns the next published command, high lane first, or 0.
+    ThreadCommand* peekCommand(int* lane)
+    {
+        ThreadCommand* command = Lanes[ThreadCommandQueue::Priority_High].Commands.PopBegin();
+        if (command)
+        {
+            *lane = ThreadCommandQueue::Priority_High;
+            return command;
+        }
+
+        command = Lanes[ThreadCommandQueue::Priority_Normal].Commands.PopBegin();
+        // High commands that made it in before exit must run first, even if their
+        // producers are still writing them.
+        if (command && command->ExitFlag &&
+            !Lanes[ThreadCommandQueue::Priority_High].Commands.IsDrained())
+            return 0;
+        *lane = ThreadCommandQueue::Priority_Normal;
+        return command;
+    }
+
+    // Called when a command with a coalesce key is popped; returns 'true' if it
+    // has been superseded by a later command with the same key.
+    bool        popCoalesced(UPInt key)
+    {
+        Lock::Locker lock(&QueueLock);
+        SPInt i = findCoalesced_NTS(key);
+        OVR_ASSERT((i >= 0) && CoalescePending[i].Count);
+        if (--CoalescePending[i].Count)
+            return true;
+        CoalescePending.RemoveAt(i);
+        return false;
+    }
+
+    // Index of key in CoalescePending, or -1; QueueLock must be held.
+    SPInt       findCoalesced_NTS(UPInt key) const
+    {
+        for (UPInt i = 0; i < CoalescePending.GetSize(); i++)
+        {
+            if (CoalescePending[i].Key == key)
+                return (SPInt)i;
+        }
+        return -1;
+    }
+
     ThreadCommandQueue* pQueue;
     Lock                QueueLock;
     volatile bool       ExitEnqueued;
     volatile bool       ExitProcessed;
+    AtomicInt<int>      ConsumerIdle;
+    unsigned            CompletionSpinCount;
     List<NotifyEvent>   AvailableEvents;
-    List<NotifyEvent>   BlockedProducers;
-    CircularBuffer      CommandBuffer;
+    Lane                Lanes[ThreadCommandQueue::Priority_Count];
+    // Lane of the command held by the PopBuffer.
+    int                 PoppedLane;
+    ArrayPOD<CoalesceCount> CoalescePending;
+
+    AtomicInt<UInt32>   NextTimerId;
+    // Thread that last called PopCommand.
+    volatile ThreadId   ConsumerThreadId;
+    ArrayPOD<TimerEntry> Timers;
+    // Set while a PopBuffer holds PoppedTimer's command.
+    bool                TimerPopped;
+    TimerEntry          PoppedTimer;
 };
 
 
@@ -237,89 +501,306 @@ public:
 ThreadCommandQueueImpl::~ThreadCommandQueueImpl()
 {
     Lock::Locker lock(&QueueLock);
-    OVR_ASSERT(BlockedProducers.IsEmpty());
+    for (int i = 0; i < ThreadCommandQueue::Priority_Count; i++)
+        OVR_ASSERT(Lanes[i].BlockedProducers.IsEmpty());
     FreeNotifyEvents_NTS();
+
+    OVR_ASSERT(!TimerPopped);
+    for (UPInt i = 0; i < Timers.GetSize(); i++)
+        freeTimerCommand(Timers[i].pCommand);
 }
 
-bool ThreadCommandQueueImpl::PushCommand(const ThreadCommand& command)
+bool ThreadCommandQueueImpl::PushCommand(const ThreadCommand& command,
+                                         ThreadCommandQueue::CommandPriority priority,
+                                         UPInt coalesceKey)
 {
-    ThreadCommand::NotifyEvent* completeEvent = 0;
-    ThreadCommand::NotifyEvent* queueAvailableEvent = 0;
+    // Don't allow any commands after PushExitCommand() is called. Commands that
+    // race with it are still rejected once the exit command is in the ring.
+    if (ExitEnqueued && !command.ExitFlag)
+        return false;
 
-    // Repeat  writing command into buffer until it is available.    
-    do {
+    OVR_ASSERT(priority < ThreadCommandQueue::Priority_Count);
+    Lane& lane = Lanes[priority];
 
-        { // Lock Scope
-            Lock::Locker lock(&QueueLock);
+    // Count the command before it can be popped.
+    if (coalesceKey)
+    {
+        Lock::Locker lock(&QueueLock);
+        SPInt i = findCoalesced_NTS(coalesceKey);
+        if (i >= 0)
+        {
+            CoalescePending[i].Count++;
+        }
+        else
+        {
+            CoalesceCount pending = { coalesceKey, 1 };
+            CoalescePending.PushBack(pending);
+        }
+    }
 
-            if (queueAvailableEvent)
-            {
-                FreeNotifyEvent_NTS(queueAvailableEvent);
-                queueAvailableEvent = 0;
-            }
+    // Signaled by the consumer after executing the command, if we wait for it.
+    CommandCompletion completion;
+    CompletionEvent*  completeEvent = command.NeedsWait() ? &completion : 0;
 
-            // Don't allow any commands after PushExitCommand() is called.
-            if (ExitEnqueued && !command.ExitFlag)
-                return false;
+    // Repeat writing command into the ring until a slot is available.
+    while(1)
+    {
+        CommandRing::PushResult result = lane.Commands.Push(command, command.ExitFlag,
+                                                            completeEvent, coalesceKey);
+        if (result == CommandRing::Push_Ok)
+            break;
 
+        if (result == CommandRing::Push_Closed)
+        {
+            if (coalesceKey)
+                popCoalesced(coalesceKey);
+            return false;
+        }
+
+        // Ring is full; park until the consumer frees a slot.
+        NotifyEvent* queueAvailableEvent;
+        { // Lock Scope
+            Lock::Locker lock(&QueueLock);
+            queueAvailableEvent = AllocNotifyEvent_NTS();
+            lane.BlockedProducers.PushBack(queueAvailableEvent);
+            lane.HasBlockedProducers.Exchange_Sync(1);
 
-            bool   bufferWasEmpty = CommandBuffer.IsEmpty();
-            UByte* buffer = CommandBuffer.Write(command.GetSize());
-            if  (buffer)
+            // The consumer may have freed slots before it could see us; if so,
+            // nobody would wake us, so retry right away instead.
+            if (!lane.Commands.IsFull())
             {
-                ThreadCommand* c = command.CopyConstruct(buffer);
-                if (c->NeedsWait())
-                    completeEvent = c->pEvent = AllocNotifyEvent_NTS();
-                // Signal-waker consumer when we add data to buffer.
-                if (bufferWasEmpty)
-                    pQueue->OnPushNonEmpty_Locked();
-                break;
+                queueAvailableEvent->RemoveNode();
+                if (lane.BlockedProducers.IsEmpty())
+                    lane.HasBlockedProducers = 0;
+                FreeNotifyEvent_NTS(queueAvailableEvent);
+                continue;
             }
-
-            queueAvailableEvent = AllocNotifyEvent_NTS();
-            BlockedProducers.PushBack(queueAvailableEvent);
         } // Lock Scope
 
         queueAvailableEvent->Wait();
 
-    } while(1);
+        Lock::Locker lock(&QueueLock);
+        FreeNotifyEvent_NTS(queueAvailableEvent);
+    }
+
+    notifyConsumer();
 
     // Command was enqueued, wait if necessary.
     if (completeEvent)
     {
-        completeEvent->Wait();
-        Lock::Locker lock(&QueueLock);
-        FreeNotifyEvent_NTS(completeEvent);
+        completeEvent->Wait(CompletionSpinCount);
+        return !completion.Superseded;
     }
-
     return true;
 }
 
 
 // Pops the next command from the thread queue, if any is available.
+// The command is executed in its ring slot, which stays in use until it is released.
 bool ThreadCommandQueueImpl::PopCommand(ThreadCommand::PopBuffer* popBuffer)
 {    
-    Lock::Locker lock(&QueueLock);
+    ConsumerThreadId = GetCurrentThreadId();
 
-    UByte* buffer = CommandBuffer.ReadBegin();
-    if (!buffer)
+    while(1)
     {
-        // Notify thread while in lock scope, enabling initialization of wait.
-        pQueue->OnPopEmpty_Locked();
-        return false;
+        popBuffer->release();
+
+        int            lane = ThreadCommandQueue::Priority_High;
+        ThreadCommand* command = Lanes[lane].Commands.PopBegin();
+
+        if (!command)
+        {
+            // Scheduled calls that are due run ahead of normal commands.
+            if (Timers.GetSize() && (Timers[0].Deadline <= Timer::GetTicks()))
+            {
+                PoppedTimer = Timers[0];
+                removeTimer(0);
+                TimerPopped = true;
+
+                popBuffer->pCommand = PoppedTimer.pCommand;
+                popBuffer->pQueue   = this;
+                return true;
+            }
+
+            command = peekCommand(&lane);
+        }
+
+        if (!command)
+        {
+            Lock::Locker lock(&QueueLock);
+
+            // Notify thread while in lock scope, enabling initialization of wait.
+            pQueue->OnPopEmpty_Locked();
+            ConsumerIdle.Exchange_Sync(1);
+
+            // A producer may have published just before seeing the idle flag.
+            command = peekCommand(&lane);
+            if (!command)
+                return false;
+            ConsumerIdle = 0;
+        }
+
+        popBuffer->pCommand = command;
+        popBuffer->pQueue   = this;
+        PoppedLane          = lane;
+
+        if (!command->CoalesceKey || !popCoalesced(command->CoalesceKey))
+            return true;
+
+        // Superseded; a waiting producer is released without running the command.
+        // Signal publishes the flag to the producer.
+        if (command->NeedsWait())
+        {
+            static_cast<CommandCompletion*>(command->pEvent)->Superseded = true;
+            command->pEvent->Signal();
+        }
     }
+}
 
-    popBuffer->InitFromBuffer(buffer);
-    CommandBuffer.ReadEnd(popBuffer->GetSize());
+void ThreadCommandQueueImpl::ReleaseCommand(ThreadCommand::PopBuffer* popBuffer)
+{
+    OVR_ASSERT(popBuffer->pQueue == this);
+    OVR_UNUSED(popBuffer);
 
-    if (!BlockedProducers.IsEmpty())
+    if (TimerPopped)
     {
-        ThreadCommand::NotifyEvent* queueAvailableEvent = BlockedProducers.GetFirst();
-        queueAvailableEvent->RemoveNode();
-        queueAvailableEvent->PulseEvent();
-        // Event is freed later by waiter.
-    }    
-    return true;
+        OVR_ASSERT(popBuffer->pCommand == PoppedTimer.pCommand);
+        TimerPopped = false;
+
+        if (PoppedTimer.Period)
+        {
+            // Skip periods that were missed, rather than running them back to back.
+            UInt64 ticksMks = Timer::GetTicks();
+            PoppedTimer.Deadline += PoppedTimer.Period;
+            if (PoppedTimer.Deadline <= ticksMks)
+                PoppedTimer.Deadline = ticksMks + PoppedTimer.Period;
+            addTimer(PoppedTimer);
+        }
+        else
+        {
+            freeTimerCommand(PoppedTimer.pCommand);
+        }
+        return;
+    }
+
+    Lane& lane = Lanes[PoppedLane];
+    lane.Commands.PopEnd();
+    lane.releaseBlockedProducer(&QueueLock);
+}
+
+
+UInt32 ThreadCommandQueueImpl::ScheduleCommand(const ThreadCommand& command,
+                                               UInt64 ticksMks, UInt64 periodMks)
+{
+    OVR_ASSERT(!command.NeedsWait());
+    if (ExitEnqueued)
+        return 0;
+
+    TimerEntry entry;
+    entry.Deadline = ticksMks;
+    entry.Period   = periodMks;
+    do {
+        entry.Id = NextTimerId.ExchangeAdd_NoSync(1) + 1;
+    } while (entry.Id == 0);
+
+    void* p = OVR_ALLOC(command.GetSize());
+    entry.pCommand = command.CopyConstruct(p);
+
+    if (isConsumerThread())
+    {
+        addTimer(entry);
+    }
+    else if (!PushCommand(AddTimerCommand(this, entry)))
+    {
+        freeTimerCommand(entry.pCommand);
+        return 0;
+    }
+    return entry.Id;
+}
+
+bool ThreadCommandQueueImpl::CancelScheduledCall(UInt32 id)
+{
+    if (isConsumerThread())
+        return cancelTimer(id);
+
+    bool result = false;
+    PushCommand(CancelTimerCommand(this, id, &result));
+    return result;
+}
+
+void ThreadCommandQueueImpl::addTimer(const TimerEntry& entry)
+{
+    Timers.PushBack(entry);
+    placeTimer(Timers.GetSize() - 1, entry);
+}
+
+void ThreadCommandQueueImpl::removeTimer(UPInt index)
+{
+    TimerEntry last = Timers.Back();
+    Timers.PopBack();
+    if (index < Timers.GetSize())
+        placeTimer(index, last);
+}
+
+// Stores entry at the heap position index, moving it up or down as needed.
+void ThreadCommandQueueImpl::placeTimer(UPInt index, const TimerEntry& entry)
+{
+    while (index > 0)
+    {
+        UPInt parent = (index - 1) / 2;
+        if (!entry.IsBefore(Timers[parent]))
+            break;
+        Timers[index] = Timers[parent];
+        index = parent;
+    }
+
+    UPInt size = Timers.GetSize();
+    while (1)
+    {
+        UPInt child = index * 2 + 1;
+        if (child >= size)
+            break;
+        if ((child + 1 < size) && Timers[child + 1].IsBefore(Timers[child]))
+            child++;
+        if (!Timers[child].IsBefore(entry))
+            break;
+        Timers[index] = Timers[child];
+        index = child;
+    }
+
+    Timers[index] = entry;
+}
+
+bool ThreadCommandQueueImpl::cancelTimer(UInt32 id)
+{
+    // A periodic call may cancel itself while it runs.
+    if (TimerPopped && (PoppedTimer.Id == id))
+    {
+        bool pending = (PoppedTimer.Period != 0);
+        PoppedTimer.Period = 0;
+        return pending;
+    }
+
+    for (UPInt i = 0; i < Timers.GetSize(); i++)
+    {
+        if (Timers[i].Id == id)
+        {
+            freeTimerCommand(Timers[i].pCommand);
+            removeTimer(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadCommand::PopBuffer::release()
+{
+    if (pCommand)
+    {
+        pQueue->ReleaseCommand(this);
+        pCommand = 0;
+        pQueue   = 0;
+    }
 }
 
 
@@ -339,6 +820,12 @@ bool ThreadCommandQueue::PushCommand(const ThreadCommand& command)
     return pImpl->PushCommand(command);
 }
 
+bool ThreadCommandQueue::PushCommand(const ThreadCommand& command,
+                                     CommandPriority priority, UPInt coalesceKey)
+{
+    return pImpl->PushCommand(command, priority, coalesceKey);
+}
+
 bool ThreadCommandQueue::PopCommand(ThreadCommand::PopBuffer* popBuffer)
 {    
     return pImpl->PopCommand(popBuffer);
@@ -358,6 +845,9 @@ void ThreadCommandQueue::PushExitCommand(bool wait)
         pImpl->ExitEnqueued = true;
     }
 
+    // Only the normal lane carries the exit command; close the others first.
+    pImpl->Lanes[Priority_High].Commands.Close();
+
     PushCommand(ThreadCommandQueueImpl::ExitCommand(pImpl, wait));
 }
 
@@ -366,5 +856,25 @@ bool ThreadCommandQueue::IsExiting() const
     return pImpl->ExitProcessed;
 }
 
+UInt32 ThreadCommandQueue::ScheduleCommand(const ThreadCommand& command,
+                                           UInt64 ticksMks, UInt64 periodMks)
+{
+    return pImpl->ScheduleCommand(command, ticksMks, periodMks);
+}
+
+bool ThreadCommandQueue::CancelScheduledCall(UInt32 id)
+{
+    return pImpl->CancelScheduledCall(id);
+}
+
+UInt64 ThreadCommandQueue::GetScheduledCallDelay(UInt64 ticksMks) const
+{
+    const ArrayPOD<ThreadCommandQueueImpl::TimerEntry>& timers = pImpl->Timers;
+
+    if (!timers.GetSize())
+        return Timer::MksPerSecond * 1000;
+    return (timers[0].Deadline > ticksMks) ? (timers[0].Deadline - ticksMks) : 0;
+}
+
 
 } // namespace OVR
@@ -21,11 +21,19 @@ otherwise accompanies this software in either electronic or hard copy form.
 #include "Kernel/OVR_List.h"
 #include "Kernel/OVR_Atomic.h"
 #include "Kernel/OVR_Threads.h"
+#include "Kernel/OVR_Timer.h"
+
+#ifdef OVR_CPP11
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#endif
 
 namespace OVR {
 
 class ThreadCommand;
 class ThreadCommandQueue;
+class ThreadCommandQueueImpl;
 
 
 //-------------------------------------------------------------------------------------
@@ -36,8 +44,9 @@ class ThreadCommand
 {
 public:    
 
-    // NotifyEvent is used by ThreadCommandQueue::PushCallAndWait to notify the
-    // calling (producer)  thread when command is completed or queue slot is available.
+    // NotifyEvent is used by ThreadCommandQueue to notify a blocked producer thread
+    // when a queue slot is available. Completion of waiting commands is signaled
+    // through a CompletionEvent on the producer's stack instead.
     class NotifyEvent : public ListNode<NotifyEvent>, public NewOverrideBase
     {
         Event E;
@@ -48,43 +57,42 @@ public:
         void PulseEvent()  { E.PulseEvent(); }
     };
 
-    // ThreadCommand::PopBuffer is temporary storage for a command popped off
-    // by ThreadCommandQueue::PopCommand. 
+    // ThreadCommand::PopBuffer refers to a command popped off by
+    // ThreadCommandQueue::PopCommand. The command stays in its queue slot until it
+    // is executed or the PopBuffer is reused or destroyed, so only one command can
+    // be held at a time.
     class PopBuffer
     {
-        enum { MaxSize = 256 };
+        friend class ThreadCommandQueueImpl;
 
-        UPInt Size;
-        union {            
-            UByte Buffer[MaxSize];
-            UPInt Align;
-        };
+        ThreadCommand*          pCommand;
+        ThreadCommandQueueImpl* pQueue;
 
-        ThreadCommand* toCommand() const { return (ThreadCommand*)Buffer; }
+        // Destroys the held command and frees its queue slot.
+        void        release();
 
     public:
-        PopBuffer() : Size(0) { }
-        ~PopBuffer();
-
-        void        InitFromBuffer(void* data);
+        PopBuffer() : pCommand(0), pQueue(0) { }
+        ~PopBuffer()                    { release(); }
 
-        bool        HasCommand() const  { return Size != 0; }
-        UPInt       GetSize() const     { return Size; }
-        bool        NeedsWait() const   { return toCommand()->NeedsWait(); }
-        NotifyEvent* GetEvent() const   { return toCommand()->pEvent; }
+        bool        HasCommand() const  { return pCommand != 0; }
+        UPInt       GetSize() const     { return pCommand->GetSize(); }
+        bool        NeedsWait() const   { return pCommand->NeedsWait(); }
+        CompletionEvent* GetEvent() const { return pCommand->pEvent; }
 
         // Execute the command and also notifies caller to finish waiting,
-        // if necessary.
+        // if necessary. The command's slot is freed afterwards.
         void        Execute();
     };
     
-    UInt16       Size;
+    UPInt        Size;
     bool         WaitFlag; 
     bool         ExitFlag; // Marks the last exit command. 
-    NotifyEvent* pEvent;
+    CompletionEvent* pEvent;
+    UPInt        CoalesceKey; // Set on the queued copy; see ThreadCommandQueue::PushCommand.
 
     ThreadCommand(UPInt size, bool waitFlag, bool exitFlag = false)
-        : Size((UInt16)size), WaitFlag(waitFlag), ExitFlag(exitFlag), pEvent(0) { }
+        : Size(size), WaitFlag(waitFlag), ExitFlag(exitFlag), pEvent(0), CoalesceKey(0) { }
     virtual ~ThreadCommand() { }
 
     bool          NeedsWait() const { return WaitFlag; }
@@ -203,13 +211,112 @@ public:
 };
 
 
+#ifdef OVR_CPP11
+
+//-------------------------------------------------------------------------------------
+// Variadic ThreadCommands, used by ThreadCommandQueue::PushFunction and PushMemberCall.
+// These are only ever constructed directly in the queue slot, so the stored function
+// object and arguments may be move-only.
+
+// Calls f, storing the result in *ret if ret is not null.
+template<class R>
+struct ThreadCallResult
+{
+    template<class F>
+    static void Invoke(F& f, R* ret) { if (ret) *ret = f(); else f(); }
+};
+template<>
+struct ThreadCallResult<void>
+{
+    template<class F>
+    static void Invoke(F& f, void*)  { f(); }
+};
+
+template<UPInt... I> struct ThreadIndexList { };
+template<UPInt N, UPInt... I>
+struct ThreadMakeIndexList : ThreadMakeIndexList<N - 1, N - 1, I...> { };
+template<UPInt... I>
+struct ThreadMakeIndexList<0, I...> { typedef ThreadIndexList<I...> Type; };
+
+// Function object calling (pClass->*pFn)(args...) with arguments stored in a tuple.
+// Each argument is forwarded as its tuple element type, so stored values are moved
+// into the call and stored references keep their value category.
+template<class C, class R, class Fn, class Tuple>
+class ThreadMemberCall
+{
+    C*      pClass;
+    Fn      pFn;
+    Tuple   Args;
+
+    template<UPInt... I>
+    R call(ThreadIndexList<I...>)
+    { return (pClass->*pFn)(std::forward<typename std::tuple_element<I, Tuple>::type>(std::get<I>(Args))...); }
+
+public:
+    template<class... A>
+    ThreadMemberCall(C* pclass, Fn fn, A&&... args)
+        : pClass(pclass), pFn(fn), Args(std::forward<A>(args)...) { }
+
+    R operator()()
+    { return call(typename ThreadMakeIndexList<std::tuple_size<Tuple>::value>::Type()); }
+};
+
+// ThreadCommand holding a function object F, which may be a reference type.
+// F is constructed from the trailing constructor arguments.
+template<class F, class R>
+class ThreadCommandFn : public ThreadCommand
+{
+    F       Fn;
+    R*      pRet;
+
+public:
+    template<class... G>
+    ThreadCommandFn(bool needsWait, R* ret, G&&... fnArgs)
+        : ThreadCommand(sizeof(ThreadCommandFn), needsWait),
+          Fn(std::forward<G>(fnArgs)...), pRet(ret) { }
+
+    virtual void           Execute() const
+    { ThreadCallResult<R>::Invoke(const_cast<F&>(Fn), pRet); }
+    // Never copied; see ThreadCommandEmplacer.
+    virtual ThreadCommand* CopyConstruct(void*) const
+    { OVR_ASSERT(false); return 0; }
+};
+
+// Stand-in passed to ThreadCommandQueue::PushCommand: its CopyConstruct builds
+// command Cmd directly in the queue slot instead of copying itself.
+template<class Cmd, class Builder>
+class ThreadCommandEmplacer : public ThreadCommand
+{
+    const Builder& Build;
+
+public:
+    ThreadCommandEmplacer(const Builder& build, bool needsWait)
+        : ThreadCommand(sizeof(Cmd), needsWait), Build(build) { }
+
+    virtual void           Execute() const { OVR_ASSERT(false); }
+    virtual ThreadCommand* CopyConstruct(void* p) const { return Build(p); }
+};
+
+#endif // OVR_CPP11
+
+
 //-------------------------------------------------------------------------------------
 // ***** ThreadCommandQueue
 
 // ThreadCommandQueue is a queue of executable function-call commands intended to be
 // serviced by a single consumer thread. Commands are added to the queue with PushCall
 // and removed with PopCall; they are processed in FIFO order. Multiple producer threads
-// are supported and will be blocked if internal data buffer is full.
+// are supported; pushing and popping don't take a lock, but producers will be blocked
+// if the internal ring of command slots is full.
+//
+// Commands pushed with Priority_High go to a separate lane that is always emptied
+// before normal commands are popped, so they don't wait behind slow operations such
+// as device enumeration. Commands are FIFO only within their lane.
+//
+// Calls can also be scheduled for a later time with PushCallAt and PushCallEvery.
+// Scheduled calls are kept in a min-heap owned by the consumer and are returned by
+// PopCommand once due, ahead of queued commands; the consumer should bound its wait
+// with GetScheduledCallDelay so that it wakes up for them.
 
 class ThreadCommandQueue
 {
@@ -224,10 +331,25 @@ public:
     // Returns 'false' if no command is available at the time of the call.
     bool PopCommand(ThreadCommand::PopBuffer* popBuffer);
 
+    enum CommandPriority
+    {
+        Priority_Normal,
+        Priority_High,
+        Priority_Count
+    };
+
     // Generic implementaion of PushCommand; enqueues a command for execution.
     // Returns 'false' if push failed, usually indicating thread shutdown.
     bool PushCommand(const ThreadCommand& command);
 
+    // Enqueues a command in the given priority lane. If coalesceKey is not 0, the
+    // command is dropped without executing when a newer command with the same key
+    // is pushed before it is popped; for a waiting command, PushCommand then returns
+    // 'false' and its result is not set. Use keys such as the address of an object
+    // plus a small constant per setting, and always push a key with the same priority.
+    bool PushCommand(const ThreadCommand& command, CommandPriority priority,
+                     UPInt coalesceKey = 0);
+
     // 
     void PushExitCommand(bool wait);
 
@@ -235,8 +357,29 @@ public:
     bool IsExiting() const;
 
 
+    // Generic implementation of PushCallAt and PushCallEvery; schedules a copy of the
+    // command to run on the consumer thread once Timer::GetTicks() reaches ticksMks,
+    // and then every periodMks microseconds if periodMks is not 0. Missed periods are
+    // skipped rather than run back to back. The command must not need a wait.
+    // Returns an id for CancelScheduledCall, or 0 if the queue is shutting down.
+    UInt32 ScheduleCommand(const ThreadCommand& command, UInt64 ticksMks, UInt64 periodMks);
+
+    // Cancels a call scheduled with PushCallAt or PushCallEvery. Once this returns the
+    // call will not start again; when called from outside the consumer thread, this
+    // waits for the consumer to process the request. Returns 'false' if no such call
+    // is pending, for example because a one-shot call has already run.
+    bool   CancelScheduledCall(UInt32 id);
+
+    // Returns the number of microseconds from ticksMks until the next scheduled call
+    // is due, 0 if one is due already, or Timer::MksPerSecond * 1000 if none is
+    // scheduled. Only to be called from the consumer thread.
+    UInt64 GetScheduledCallDelay(UInt64 ticksMks) const;
+
+
     // These two virtual functions serve as notifications for derived
-    // thread waiting.    
+    // thread waiting. OnPopEmpty_Locked is called when PopCommand finds the queue
+    // empty; OnPushNonEmpty_Locked is called after a push once the consumer has
+    // gone idle. Both are called with the queue's internal lock held.
     virtual void OnPushNonEmpty_Locked() { }
     virtual void OnPopEmpty_Locked()     { }
 
@@ -298,6 +441,85 @@ public:
                                typename SelfType<A0>::Type a0, typename SelfType<A1>::Type a1)
     { return PushCommand(ThreadCommandMF2<C,R,A0,A1>(p, fn, ret, a0, a1, true)); }
 
+
+    // *** Scheduled PushCall
+
+    // Enqueue a member function call of class C to run on the consumer thread once
+    // Timer::GetTicks() reaches ticksMks. Returns an id for CancelScheduledCall, or 0.
+    template<class C, class R>
+    UInt32 PushCallAt(UInt64 ticksMks, C* p, R (C::*fn)())
+    { return ScheduleCommand(ThreadCommandMF0<C,R>(p, fn, 0, false), ticksMks, 0); }
+    template<class C, class R, class A0>
+    UInt32 PushCallAt(UInt64 ticksMks, C* p, R (C::*fn)(A0), typename SelfType<A0>::Type a0)
+    { return ScheduleCommand(ThreadCommandMF1<C,R,A0>(p, fn, 0, a0, false), ticksMks, 0); }
+    template<class C, class R, class A0, class A1>
+    UInt32 PushCallAt(UInt64 ticksMks, C* p, R (C::*fn)(A0, A1),
+                      typename SelfType<A0>::Type a0, typename SelfType<A1>::Type a1)
+    { return ScheduleCommand(ThreadCommandMF2<C,R,A0,A1>(p, fn, 0, a0, a1, false), ticksMks, 0); }
+
+    // Enqueue a member function call of class C to run on the consumer thread every
+    // periodMks microseconds, starting one period from now, until it is cancelled.
+    template<class C, class R>
+    UInt32 PushCallEvery(UInt64 periodMks, C* p, R (C::*fn)())
+    { return ScheduleCommand(ThreadCommandMF0<C,R>(p, fn, 0, false), Timer::GetTicks() + periodMks, periodMks); }
+    template<class C, class R, class A0>
+    UInt32 PushCallEvery(UInt64 periodMks, C* p, R (C::*fn)(A0), typename SelfType<A0>::Type a0)
+    { return ScheduleCommand(ThreadCommandMF1<C,R,A0>(p, fn, 0, a0, false), Timer::GetTicks() + periodMks, periodMks); }
+    template<class C, class R, class A0, class A1>
+    UInt32 PushCallEvery(UInt64 periodMks, C* p, R (C::*fn)(A0, A1),
+                         typename SelfType<A0>::Type a0, typename SelfType<A1>::Type a1)
+    { return ScheduleCommand(ThreadCommandMF2<C,R,A0,A1>(p, fn, 0, a0, a1, false), Timer::GetTicks() + periodMks, periodMks); }
+
+
+#ifdef OVR_CPP11
+    // *** Variadic PushFunction / PushMemberCall
+
+    // Enqueue a function object, such as a lambda, to be called on the consumer thread.
+    // It is moved or copied straight into the queue slot; move-only types work.
+    template<class F>
+    bool PushFunction(F&& fn, bool wait = false)
+    {
+        typedef ThreadCommandFn<typename std::decay<F>::type, void> Cmd;
+        return emplaceCommand<Cmd>(wait, (void*)0, std::forward<F>(fn));
+    }
+    // Calls fn on the consumer thread and waits for the result. fn is referenced
+    // in place, since it outlives the call.
+    template<class F, class R>
+    bool PushFunctionAndWaitResult(F&& fn, R* ret)
+    {
+        typedef ThreadCommandFn<typename std::remove_reference<F>::type&, R> Cmd;
+        return emplaceCommand<Cmd>(true, ret, fn);
+    }
+
+    // Enqueue a call of a member function with any number of arguments. Arguments
+    // are converted to the parameter types and moved or copied into the queue slot.
+    template<class C, class R, class... P, class... A>
+    bool PushMemberCall(C* p, R (C::*fn)(P...), A&&... args)
+    {
+        typedef ThreadMemberCall<C, R, R (C::*)(P...), std::tuple<typename std::decay<P>::type...> > Call;
+        typedef ThreadCommandFn<Call, void> Cmd;
+        return emplaceCommand<Cmd>(false, (void*)0, p, fn, std::forward<A>(args)...);
+    }
+    // Calls a member function on the consumer thread and waits for it to complete;
+    // ret may be null. The arguments are passed by reference, without copies.
+    template<class C, class R, class... P, class... A>
+    bool PushMemberCallAndWaitResult(C* p, R (C::*fn)(P...), typename SelfType<R>::Type* ret, A&&... args)
+    {
+        typedef ThreadMemberCall<C, R, R (C::*)(P...), std::tuple<A&&...> > Call;
+        typedef ThreadCommandFn<Call, R> Cmd;
+        return emplaceCommand<Cmd>(true, ret, p, fn, std::forward<A>(args)...);
+    }
+
+private:
+    // Constructs Cmd from args directly in the queue slot.
+    template<class Cmd, class... A>
+    bool emplaceCommand(bool wait, A&&... args)
+    {
+        auto build = [&](void* p) -> ThreadCommand* { return ::new(p) Cmd(wait, std::forward<A>(args)...); };
+        return PushCommand(ThreadCommandEmplacer<Cmd, decltype(build)>(build, wait));
+    }
+#endif // OVR_CPP11
+
 private:
     class ThreadCommandQueueImpl* pImpl;
 };
@@ -183,22 +183,28 @@ int DeviceManagerThread::Run()
                 UPInt numberOfWaitHandles = WaitHandles.GetSize();
 				Debug_WaitedObjectCount = (DWORD)numberOfWaitHandles;
 
-                DWORD waitMs = INFINITE;
+                UInt64 ticksMks = Timer::GetTicks();
+
+                // Go back to PopCommand once a scheduled call is due; otherwise wait
+                // no longer than until the next one.
+                UInt64 waitMks = GetScheduledCallDelay(ticksMks);
+                if (waitMks == 0)
+                    break;
 
                 // If devices have time-dependent logic registered, get the longest wait
                 // allowed based on current ticks.
-                if (!TicksNotifiers.IsEmpty())
+                for (UPInt j = 0; j < TicksNotifiers.GetSize(); j++)
                 {
-                    UInt64 ticksMks = Timer::GetTicks();
-                    DWORD  waitAllowed;
-                    
-                    for (UPInt j = 0; j < TicksNotifiers.GetSize(); j++)
-                    {
-                        waitAllowed = (DWORD)(TicksNotifiers[j]->OnTicks(ticksMks) / Timer::MksPerMs);
-                        if (waitAllowed < waitMs)
-                            waitMs = waitAllowed;
-                    }
+                    UInt64 waitAllowed = TicksNotifiers[j]->OnTicks(ticksMks);
+                    if (waitAllowed < waitMks)
+                        waitMks = waitAllowed;
                 }
+
+                // Round up, so that the wait doesn't end just short of the deadline.
+                // MksPerSecond * 1000 means nothing is scheduled, so block until signaled.
+                DWORD waitMs = INFINITE;
+                if (waitMks < Timer::MksPerSecond * 1000)
+                    waitMs = (DWORD)((waitMks + Timer::MksPerMs - 1) / Timer::MksPerMs);
           
 				// Wait for event signals or window messages.
                 eventIndex = MsgWaitForMultipleObjects((DWORD)numberOfWaitHandles, &WaitHandles[0], FALSE, waitMs, QS_ALLINPUT);
@@ -283,7 +283,6 @@ bool HIDDevice::HIDInitialize(const String& path)
     }
 
 
-    HIDManager->Manager->pThread->AddTicksNotifier(this);
     HIDManager->Manager->pThread->AddMessageNotifier(this);
 
     LogText("OVR::Win32::HIDDevice - Opened '%s'\n"
@@ -398,7 +397,6 @@ bool HIDDevice::openDevice()
 void HIDDevice::HIDShutdown()
 {   
 
-    HIDManager->Manager->pThread->RemoveTicksNotifier(this);
     HIDManager->Manager->pThread->RemoveMessageNotifier(this);
 
     closeDevice();
@@ -515,16 +513,6 @@ void HIDDevice::OnOverlappedEvent(HANDLE hevent)
     }
 }
 
-UInt64 HIDDevice::OnTicks(UInt64 ticksMks)
-{
-    if (Handler)
-    {
-        return Handler->OnTicks(ticksMks);
-    }
-
-    return DeviceManagerThread::Notifier::OnTicks(ticksMks);
-}
-
 bool HIDDevice::OnDeviceMessage(DeviceMessageType messageType, 
 								const String& devicePath,
 								bool* error)
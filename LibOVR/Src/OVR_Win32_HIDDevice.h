@@ -96,7 +96,6 @@ public:
 
     // DeviceManagerThread::Notifier
     void OnOverlappedEvent(HANDLE hevent);
-    UInt64 OnTicks(UInt64 ticksMks);
     bool OnDeviceMessage(DeviceMessageType messageType, const String& devicePath, bool* error);
 
 private:
@@ -0,0 +1,76 @@
+/************************************************************************************
+
+Filename    :   Util_FusionBatch.cpp
+Content     :   Offline fusion of many recorded sensor traces across worker threads
+Created     :   October 19, 2026
+Authors     :
+
+Copyright   :   Copyright 2013 Oculus VR, Inc. All Rights reserved.
+
+Use of this software is subject to the terms of the Oculus license
+agreement provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+*************************************************************************************/
+
+#include "Util_FusionBatch.h"
+#include "../Kernel/OVR_Timer.h"
+
+namespace OVR { namespace Util {
+
+FusionBatch::FusionBatch()
+    : EnableGravity(true), EnableYawCorrection(false)
+{
+}
+
+FusionBatch::~FusionBatch()
+{
+}
+
+FusionBatch::Stats FusionBatch::Run(int threadCount)
+{
+    Stats stats;
+    stats.TraceCount = Traces.GetSize();
+    for (UPInt i = 0; i < Traces.GetSize(); i++)
+        stats.SampleCount += Traces[i].SampleCount;
+
+    if (threadCount <= 0)
+        threadCount = Thread::GetCPUCount();
+    if ((UPInt)threadCount > Traces.GetSize())
+        threadCount = (int)Traces.GetSize();
+    if (threadCount < 1)
+        threadCount = 1;
+    stats.ThreadCount = threadCount;
+
+    UInt64 startTicks = Timer::GetProfileTicks();
+
+    // With a single thread, the scheduler starts no workers and everything runs here.
+    TaskScheduler scheduler(threadCount);
+    TraceRange    body;
+    body.pBatch = this;
+    ParallelForRange(&scheduler, 0, Traces.GetSize(), body, 1);
+
+    stats.Seconds = Timer::TicksToSeconds(Timer::GetProfileTicks() - startTicks);
+    if (stats.Seconds > 0)
+        stats.SamplesPerSecond = (double)stats.SampleCount / stats.Seconds;
+    return stats;
+}
+
+void FusionBatch::TraceRange::operator()(UPInt begin, UPInt end) const
+{
+    for (UPInt i = begin; i < end; i++)
+        pBatch->fuseTrace(pBatch->Traces[i]);
+}
+
+void FusionBatch::fuseTrace(const FusionTrace& trace)
+{
+    SensorFusion fusion;
+    fusion.SetGravityEnabled(EnableGravity);
+    fusion.SetYawCorrectionEnabled(EnableYawCorrection);
+    if (trace.pMagCalibration)
+        fusion.SetMagCalibration(*trace.pMagCalibration);
+
+    fusion.FuseBatch(trace.pSamples, trace.SampleCount, trace.pOrientations);
+}
+
+}} // namespace OVR::Util
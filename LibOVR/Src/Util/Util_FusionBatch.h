@@ -0,0 +1,102 @@
+/************************************************************************************
+
+PublicHeader:   None
+Filename    :   Util_FusionBatch.h
+Content     :   Offline fusion of many recorded sensor traces across worker threads
+Created     :   October 19, 2026
+Authors     :
+
+Copyright   :   Copyright 2013 Oculus VR, Inc. All Rights reserved.
+
+Use of this software is subject to the terms of the Oculus license
+agreement provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+*************************************************************************************/
+
+#ifndef OVR_Util_FusionBatch_h
+#define OVR_Util_FusionBatch_h
+
+#include "../OVR_SensorFusion.h"
+#include "../Kernel/OVR_Array.h"
+#include "../Kernel/OVR_TaskScheduler.h"
+
+namespace OVR { namespace Util {
+
+//-------------------------------------------------------------------------------------
+// ***** FusionTrace
+
+// FusionTrace describes one recorded head-motion session. The sample and output
+// arrays are owned by the caller and must stay valid until FusionBatch::Run returns.
+struct FusionTrace
+{
+    const MessageBodyFrame* pSamples;
+    UPInt                   SampleCount;
+    // Receives the fused orientation after every sample; may be null.
+    Quatf*                  pOrientations;
+    // Magnetometer calibration to apply for this trace; null leaves it uncalibrated.
+    const Matrix4f*         pMagCalibration;
+
+    FusionTrace(const MessageBodyFrame* samples = 0, UPInt count = 0,
+                Quatf* orientations = 0, const Matrix4f* magCalibration = 0)
+        : pSamples(samples), SampleCount(count),
+          pOrientations(orientations), pMagCalibration(magCalibration) { }
+};
+
+
+//-------------------------------------------------------------------------------------
+// ***** FusionBatch
+//
+// FusionBatch fuses a set of independent traces, each with its own SensorFusion
+// instance fed through SensorFusion::FuseBatch. Traces are handed out to the threads
+// of a TaskScheduler one at a time, so throughput scales with the number of cores as
+// long as there are at least as many traces as workers.
+
+class FusionBatch : public NewOverrideBase
+{
+public:
+    struct Stats
+    {
+        UPInt   TraceCount;
+        UPInt   SampleCount;
+        int     ThreadCount;
+        double  Seconds;
+        double  SamplesPerSecond;
+
+        Stats() : TraceCount(0), SampleCount(0), ThreadCount(0),
+                  Seconds(0), SamplesPerSecond(0) { }
+    };
+
+    FusionBatch();
+    ~FusionBatch();
+
+    void    AddTrace(const FusionTrace& trace)  { Traces.PushBack(trace); }
+    void    ClearTraces()                       { Traces.Clear(); }
+    UPInt   GetTraceCount() const               { return Traces.GetSize(); }
+
+    // Settings applied to the SensorFusion created for every trace.
+    void    SetGravityEnabled(bool enable)      { EnableGravity = enable; }
+    void    SetYawCorrectionEnabled(bool enable){ EnableYawCorrection = enable; }
+
+    // Fuses all traces using up to threadCount threads, including the calling one;
+    // 0 selects Thread::GetCPUCount(). Blocks until every trace is processed.
+    Stats   Run(int threadCount = 0);
+
+private:
+    // ParallelForRange body over trace indices.
+    struct TraceRange
+    {
+        FusionBatch* pBatch;
+        void operator()(UPInt begin, UPInt end) const;
+    };
+
+    void        fuseTrace(const FusionTrace& trace);
+
+    Array<FusionTrace>  Traces;
+    bool                EnableGravity;
+    bool                EnableYawCorrection;
+};
+
+}} // namespace OVR::Util
+
+#endif // OVR_Util_FusionBatch_h
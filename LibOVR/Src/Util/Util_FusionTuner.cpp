@@ -0,0 +1,340 @@
+/************************************************************************************
+
+Filename    :   Util_FusionTuner.cpp
+Content     :   Parameter sweeps over SensorFusion settings using recorded traces
+Created     :   October 19, 2026
+Authors     :
+
+Copyright   :   Copyright 2013 Oculus VR, Inc. All Rights reserved.
+
+Use of this software is subject to the terms of the Oculus license
+agreement provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+*************************************************************************************/
+
+#include "Util_FusionTuner.h"
+#include "../Kernel/OVR_Timer.h"
+#include "../Kernel/OVR_Log.h"
+
+namespace OVR { namespace Util {
+
+// Rotation angle (rad) taking orientation a to orientation b.
+static float quatAngleBetween(const Quatf& a, const Quatf& b)
+{
+    float d = fabs(a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w) / (a.Length() * b.Length());
+    if (d > 1.0f)
+        d = 1.0f;
+    return 2.0f * acos(d);
+}
+
+
+//-------------------------------------------------------------------------------------
+// ***** FusionParams
+
+void FusionParams::Apply(SensorFusion* fusion) const
+{
+    fusion->SetAccelGain(Gain);
+    fusion->SetPrediction(PredictionDT);
+    fusion->SetMagRefDistance(MagRefDistance);
+    fusion->SetTuning(Tuning);
+}
+
+
+//-------------------------------------------------------------------------------------
+// ***** FusionTuner
+
+FusionTuner::FusionTuner()
+    : EnableGravity(true), EnableYawCorrection(false), MaxTraceLength(0)
+{
+}
+
+FusionTuner::~FusionTuner()
+{
+}
+
+void FusionTuner::SetSweepValues(Param p, const float* values, int count)
+{
+    OVR_ASSERT(p >= 0 && p < Param_Count);
+    SweepValues[p].Clear();
+    for (int i = 0; i < count; i++)
+        SweepValues[p].PushBack(values[i]);
+}
+
+void FusionTuner::ClearSweep()
+{
+    for (int i = 0; i < Param_Count; i++)
+        SweepValues[i].Clear();
+}
+
+UPInt FusionTuner::GetConfigCount() const
+{
+    const UPInt maxCount = ~(UPInt)0;
+    UPInt       count    = 1;
+    for (int i = 0; i < Param_Count; i++)
+    {
+        UPInt n = SweepValues[i].GetSize();
+        if (n == 0)
+            continue;
+        if (count > maxCount / n)
+            return maxCount;
+        count *= n;
+    }
+    return count;
+}
+
+void FusionTuner::getConfig(UPInt index, FusionParams* params) const
+{
+    // Mixed-radix decode of the configuration index, one digit per swept parameter.
+    *params = BaseParams;
+    for (int i = 0; i < Param_Count; i++)
+    {
+        UPInt n = SweepValues[i].GetSize();
+        if (n)
+        {
+            SetParam(params, (Param)i, SweepValues[i][index % n]);
+            index /= n;
+        }
+    }
+}
+
+bool FusionTuner::Run(int threadCount)
+{
+    UPInt configCount = GetConfigCount();
+    Results.Clear();
+    OVR_ASSERT(configCount <= MaxConfigCount);
+    if (configCount > MaxConfigCount)
+        return false;
+
+    MaxTraceLength = 0;
+    for (UPInt i = 0; i < Traces.GetSize(); i++)
+    {
+        if (Traces[i].SampleCount > MaxTraceLength)
+            MaxTraceLength = Traces[i].SampleCount;
+    }
+
+    Results.Resize(configCount);
+    for (UPInt i = 0; i < configCount; i++)
+        getConfig(i, &Results[i].Params);
+
+    if (threadCount <= 0)
+        threadCount = Thread::GetCPUCount();
+    if ((UPInt)threadCount > configCount)
+        threadCount = (int)configCount;
+    if (threadCount < 1)
+        threadCount = 1;
+
+    {
+        TaskScheduler scheduler(threadCount);
+        ConfigRange   body;
+        body.pTuner = this;
+        ParallelForRange(&scheduler, 0, configCount, body, 1);
+    }
+
+    markParetoFront();
+    return true;
+}
+
+void FusionTuner::ConfigRange::operator()(UPInt begin, UPInt end) const
+{
+    pTuner->processConfigs(begin, end);
+}
+
+void FusionTuner::processConfigs(UPInt begin, UPInt end)
+{
+    // Scratch space for the fused and predicted orientation of every sample; small
+    // next to the cost of fusing all traces for even one configuration.
+    ArrayPOD<Quatf> fused;
+    ArrayPOD<Quatf> predicted;
+    fused.Resize(MaxTraceLength);
+    predicted.Resize(MaxTraceLength);
+
+    for (UPInt i = begin; i < end; i++)
+        evaluate(&Results[i], fused.GetDataPtr(), predicted.GetDataPtr());
+}
+
+void FusionTuner::evaluate(Result* result, Quatf* fused, Quatf* predicted) const
+{
+    const FusionParams& params = result->Params;
+
+    double driftSum   = 0;
+    UPInt  driftCount = 0;
+    double predSum    = 0;
+    UPInt  predCount  = 0;
+    UPInt  samples    = 0;
+    UInt64 ticks      = 0;
+
+    for (UPInt t = 0; t < Traces.GetSize(); t++)
+    {
+        const TunerTrace& trace = Traces[t];
+        UPInt             n     = trace.SampleCount;
+
+        SensorFusion fusion;
+        fusion.SetGravityEnabled(EnableGravity);
+        fusion.SetYawCorrectionEnabled(EnableYawCorrection);
+        if (trace.pMagCalibration)
+            fusion.SetMagCalibration(*trace.pMagCalibration);
+        params.Apply(&fusion);
+
+        UInt64 startTicks = Timer::GetProfileTicks();
+        for (UPInt i = 0; i < n; i++)
+        {
+            fusion.FuseBatch(&trace.pSamples[i], 1, &fused[i]);
+            predicted[i] = fusion.GetPredictedOrientation();
+        }
+        ticks   += Timer::GetProfileTicks() - startTicks;
+        samples += n;
+
+        if (trace.pTruth)
+        {
+            for (UPInt i = 0; i < n; i++)
+                driftSum += quatAngleBetween(fused[i], trace.pTruth[i]);
+            driftCount += n;
+        }
+
+        // Compare each prediction with the orientation reached PredictionDT later;
+        // 'ahead' tracks the time from sample i to sample j.
+        const Quatf* actual = trace.pTruth ? trace.pTruth : fused;
+        UPInt        j      = 0;
+        float        ahead  = 0;
+        for (UPInt i = 0; i < n; i++)
+        {
+            if (j < i)
+            {
+                j     = i;
+                ahead = 0;
+            }
+            while ((j + 1 < n) && (ahead < params.PredictionDT))
+                ahead += trace.pSamples[++j].TimeDelta;
+            if (ahead < params.PredictionDT)
+                break;
+
+            predSum += quatAngleBetween(predicted[i], actual[j]);
+            predCount++;
+
+            if (j > i)
+                ahead -= trace.pSamples[i + 1].TimeDelta;
+        }
+    }
+
+    result->Drift            = driftCount ? (float)(driftSum / driftCount) : 0.0f;
+    result->PredictionError  = predCount ? (float)(predSum / predCount) : 0.0f;
+    result->SecondsPerSample = samples ? Timer::TicksToSeconds(ticks) / samples : 0.0;
+}
+
+void FusionTuner::markParetoFront()
+{
+    UPInt count = Results.GetSize();
+    for (UPInt i = 0; i < count; i++)
+    {
+        const Result& a = Results[i];
+        bool dominated = false;
+
+        for (UPInt j = 0; (j < count) && !dominated; j++)
+        {
+            const Result& b = Results[j];
+            if ((j == i) ||
+                (b.Drift > a.Drift) || (b.PredictionError > a.PredictionError) ||
+                (b.SecondsPerSample > a.SecondsPerSample))
+                continue;
+            // b is no worse on every cost; it dominates if strictly better on one.
+            dominated = (b.Drift < a.Drift) || (b.PredictionError < a.PredictionError) ||
+                        (b.SecondsPerSample < a.SecondsPerSample);
+        }
+        Results[i].ParetoOptimal = !dominated;
+    }
+}
+
+void FusionTuner::LogParetoFront() const
+{
+    for (UPInt i = 0; i < Results.GetSize(); i++)
+    {
+        const Result& r = Results[i];
+        if (!r.ParetoOptimal)
+            continue;
+
+        LogText("Config %d: drift %f rad, prediction error %f rad, %f us/sample\n",
+                (int)i, r.Drift, r.PredictionError, r.SecondsPerSample * 1000000.0);
+        for (int p = 0; p < Param_Count; p++)
+        {
+            if (SweepValues[p].GetSize())
+                LogText("    %s = %g\n", GetParamName((Param)p), GetParam(r.Params, (Param)p));
+        }
+    }
+}
+
+void FusionTuner::SetParam(FusionParams* params, Param p, float value)
+{
+    SensorFusion::TuningParams& t = params->Tuning;
+    switch(p)
+    {
+    case Param_Gain:                params->Gain           = value; break;
+    case Param_PredictionDT:        params->PredictionDT   = value; break;
+    case Param_MagRefDistance:      params->MagRefDistance = value; break;
+    case Param_MagFilterSize:       t.MagFilterSize        = (int)value; break;
+    case Param_AccelFilterSize:     t.AccelFilterSize      = (int)value; break;
+    case Param_AngVelFilterSize:    t.AngVelFilterSize     = (int)value; break;
+    case Param_UseMedianFilter:     t.UseMedianFilter      = (value != 0.0f); break;
+    case Param_GravityEpsilon:      t.GravityEpsilon       = value; break;
+    case Param_AngVelEpsilon:       t.AngVelEpsilon        = value; break;
+    case Param_TiltPeriod:          t.TiltPeriod           = (int)value; break;
+    case Param_MaxTiltError:        t.MaxTiltError         = value; break;
+    case Param_MinTiltError:        t.MinTiltError         = value; break;
+    case Param_MaxAngVelLength:     t.MaxAngVelLength      = value; break;
+    case Param_YawErrorMax:         t.YawErrorMax          = value; break;
+    case Param_YawErrorMin:         t.YawErrorMin          = value; break;
+    case Param_YawErrorCountLimit:  t.YawErrorCountLimit   = (int)value; break;
+    case Param_YawRotationStep:     t.YawRotationStep      = value; break;
+    case Param_TiltCorrectionPeriod: t.TiltCorrectionPeriod = (int)value; break;
+    case Param_YawCorrectionPeriod: t.YawCorrectionPeriod  = (int)value; break;
+    default:
+        OVR_ASSERT(false);
+        break;
+    }
+}
+
+float FusionTuner::GetParam(const FusionParams& params, Param p)
+{
+    const SensorFusion::TuningParams& t = params.Tuning;
+    switch(p)
+    {
+    case Param_Gain:                return params.Gain;
+    case Param_PredictionDT:        return params.PredictionDT;
+    case Param_MagRefDistance:      return params.MagRefDistance;
+    case Param_MagFilterSize:       return (float)t.MagFilterSize;
+    case Param_AccelFilterSize:     return (float)t.AccelFilterSize;
+    case Param_AngVelFilterSize:    return (float)t.AngVelFilterSize;
+    case Param_UseMedianFilter:     return t.UseMedianFilter ? 1.0f : 0.0f;
+    case Param_GravityEpsilon:      return t.GravityEpsilon;
+    case Param_AngVelEpsilon:       return t.AngVelEpsilon;
+    case Param_TiltPeriod:          return (float)t.TiltPeriod;
+    case Param_MaxTiltError:        return t.MaxTiltError;
+    case Param_MinTiltError:        return t.MinTiltError;
+    case Param_MaxAngVelLength:     return t.MaxAngVelLength;
+    case Param_YawErrorMax:         return t.YawErrorMax;
+    case Param_YawErrorMin:         return t.YawErrorMin;
+    case Param_YawErrorCountLimit:  return (float)t.YawErrorCountLimit;
+    case Param_YawRotationStep:     return t.YawRotationStep;
+    case Param_TiltCorrectionPeriod: return (float)t.TiltCorrectionPeriod;
+    case Param_YawCorrectionPeriod: return (float)t.YawCorrectionPeriod;
+    default:
+        OVR_ASSERT(false);
+        return 0.0f;
+    }
+}
+
+const char* FusionTuner::GetParamName(Param p)
+{
+    static const char* names[Param_Count] =
+    {
+        "Gain", "PredictionDT", "MagRefDistance",
+        "MagFilterSize", "AccelFilterSize", "AngVelFilterSize", "UseMedianFilter",
+        "GravityEpsilon", "AngVelEpsilon", "TiltPeriod", "MaxTiltError", "MinTiltError",
+        "MaxAngVelLength", "YawErrorMax", "YawErrorMin", "YawErrorCountLimit",
+        "YawRotationStep", "TiltCorrectionPeriod", "YawCorrectionPeriod"
+    };
+    OVR_ASSERT(p >= 0 && p < Param_Count);
+    return names[p];
+}
+
+}} // namespace OVR::Util
@@ -0,0 +1,175 @@
+/************************************************************************************
+
+PublicHeader:   None
+Filename    :   Util_FusionTuner.h
+Content     :   Parameter sweeps over SensorFusion settings using recorded traces
+Created     :   October 19, 2026
+Authors     :
+
+Copyright   :   Copyright 2013 Oculus VR, Inc. All Rights reserved.
+
+Use of this software is subject to the terms of the Oculus license
+agreement provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+*************************************************************************************/
+
+#ifndef OVR_Util_FusionTuner_h
+#define OVR_Util_FusionTuner_h
+
+#include "../OVR_SensorFusion.h"
+#include "../Kernel/OVR_Array.h"
+#include "../Kernel/OVR_TaskScheduler.h"
+
+namespace OVR { namespace Util {
+
+//-------------------------------------------------------------------------------------
+// ***** FusionParams
+
+// Complete set of SensorFusion settings explored by FusionTuner.
+struct FusionParams
+{
+    float                       Gain;
+    float                       PredictionDT;
+    float                       MagRefDistance;
+    SensorFusion::TuningParams  Tuning;
+
+    FusionParams() : Gain(0.05f), PredictionDT(0.03f), MagRefDistance(0.5f) { }
+
+    // Applies these settings to a fusion object.
+    void Apply(SensorFusion* fusion) const;
+};
+
+
+//-------------------------------------------------------------------------------------
+// ***** TunerTrace
+
+// A recorded or synthetic trace to evaluate parameters against. The arrays are owned
+// by the caller and must stay valid until FusionTuner::Run returns.
+struct TunerTrace
+{
+    const MessageBodyFrame* pSamples;
+    UPInt                   SampleCount;
+    // Ground truth orientation after every sample. Synthetic traces can provide it;
+    // without it drift is not scored and prediction is scored against the fused output.
+    const Quatf*            pTruth;
+    const Matrix4f*         pMagCalibration;
+
+    TunerTrace(const MessageBodyFrame* samples = 0, UPInt count = 0,
+               const Quatf* truth = 0, const Matrix4f* magCalibration = 0)
+        : pSamples(samples), SampleCount(count),
+          pTruth(truth), pMagCalibration(magCalibration) { }
+};
+
+
+//-------------------------------------------------------------------------------------
+// ***** FusionTuner
+//
+// FusionTuner runs every combination of the configured parameter values over all
+// traces, spreading configurations across the threads of a TaskScheduler. Each
+// configuration is scored on three costs, all lower-is-better:
+//  - Drift: mean angle (rad) between the fused and true orientation.
+//  - PredictionError: mean angle (rad) between GetPredictedOrientation() and the
+//    orientation actually reached PredictionDT seconds later.
+//  - SecondsPerSample: CPU time of the per-sample update plus prediction.
+// Configurations not dominated on all three costs by another are marked ParetoOptimal.
+
+class FusionTuner : public NewOverrideBase
+{
+public:
+    enum Param
+    {
+        Param_Gain,
+        Param_PredictionDT,
+        Param_MagRefDistance,
+        Param_MagFilterSize,
+        Param_AccelFilterSize,
+        Param_AngVelFilterSize,
+        Param_UseMedianFilter,      // 0 or 1
+        Param_GravityEpsilon,
+        Param_AngVelEpsilon,
+        Param_TiltPeriod,
+        Param_MaxTiltError,
+        Param_MinTiltError,
+        Param_MaxAngVelLength,
+        Param_YawErrorMax,
+        Param_YawErrorMin,
+        Param_YawErrorCountLimit,
+        Param_YawRotationStep,
+        Param_TiltCorrectionPeriod,
+        Param_YawCorrectionPeriod,
+        Param_Count
+    };
+
+    struct Result
+    {
+        FusionParams    Params;
+        float           Drift;
+        float           PredictionError;
+        double          SecondsPerSample;
+        bool            ParetoOptimal;
+
+        Result() : Drift(0), PredictionError(0), SecondsPerSample(0), ParetoOptimal(false) { }
+    };
+
+    FusionTuner();
+    ~FusionTuner();
+
+    void    AddTrace(const TunerTrace& trace)   { Traces.PushBack(trace); }
+    void    ClearTraces()                       { Traces.Clear(); }
+
+    // Parameters that are not swept keep the value from the base parameters.
+    void    SetBaseParams(const FusionParams& params) { BaseParams = params; }
+    void    SetGravityEnabled(bool enable)      { EnableGravity = enable; }
+    void    SetYawCorrectionEnabled(bool enable){ EnableYawCorrection = enable; }
+
+    // Sets the list of values to try for a parameter; count == 0 stops sweeping it.
+    void    SetSweepValues(Param p, const float* values, int count);
+    void    ClearSweep();
+    // Run refuses sweeps of more configurations than this; each one fuses every
+    // trace, so larger sweeps would not finish in reasonable time anyway.
+    enum { MaxConfigCount = 1 << 20 };
+
+    // Number of configurations Run will evaluate (product of all value counts),
+    // saturated at the largest UPInt.
+    UPInt   GetConfigCount() const;
+
+    // Evaluates all configurations using up to threadCount threads, including the
+    // calling one; 0 selects Thread::GetCPUCount(). Blocks until done. Returns false,
+    // with no results, if GetConfigCount() exceeds MaxConfigCount.
+    bool    Run(int threadCount = 0);
+
+    const Array<Result>& GetResults() const     { return Results; }
+    // Writes the Pareto-optimal configurations to the log.
+    void    LogParetoFront() const;
+
+    static void        SetParam(FusionParams* params, Param p, float value);
+    static float       GetParam(const FusionParams& params, Param p);
+    static const char* GetParamName(Param p);
+
+private:
+    // ParallelForRange body over configuration indices.
+    struct ConfigRange
+    {
+        FusionTuner* pTuner;
+        void operator()(UPInt begin, UPInt end) const;
+    };
+
+    void        processConfigs(UPInt begin, UPInt end);
+    void        getConfig(UPInt index, FusionParams* params) const;
+    void        evaluate(Result* result, Quatf* fused, Quatf* predicted) const;
+    void        markParetoFront();
+
+    Array<TunerTrace>   Traces;
+    FusionParams        BaseParams;
+    Array<float>        SweepValues[Param_Count];
+    bool                EnableGravity;
+    bool                EnableYawCorrection;
+    UPInt               MaxTraceLength;
+
+    Array<Result>       Results;
+};
+
+}} // namespace OVR::Util
+
+#endif // OVR_Util_FusionTuner_h
@@ -177,4 +177,156 @@ float MagCalibration::PointToPlaneDistance(const Vector3f& p1, const Vector3f& p
     return (fabs((planeNormal * p4) - planeNormal * p1));
 }
 
+
+//-------------------------------------------------------------------------------------
+// ***** StreamingMagCalibration
+
+StreamingMagCalibration::StreamingMagCalibration()
+  : MagCenter(0), Radius(0), Residual(0),
+    MinMagDistanceSq(0.05f * 0.05f), SolvePeriod(100), MaxResidualRatio(0.05f),
+    ForgetFactor(1.0f)
+{
+    Reset();
+}
+
+void StreamingMagCalibration::Reset()
+{
+    N   = 0;
+    Sx  = Sy  = Sz  = 0;
+    Sxx = Sxy = Sxz = Syy = Syz = Szz = 0;
+    Sb  = Sxb = Syb = Szb = Sbb = 0;
+    HasOrigin  = false;
+    SinceSolve = 0;
+}
+
+void StreamingMagCalibration::AddSample(const Vector3f& m)
+{
+    if (!HasOrigin)
+    {
+        Origin    = m;
+        HasOrigin = true;
+    }
+
+    if (ForgetFactor < 1.0f)
+    {
+        double f = ForgetFactor;
+        N   *= f;
+        Sx  *= f; Sy  *= f; Sz  *= f;
+        Sxx *= f; Sxy *= f; Sxz *= f; Syy *= f; Syz *= f; Szz *= f;
+        Sb  *= f; Sxb *= f; Syb *= f; Szb *= f; Sbb *= f;
+    }
+
+    double x = m.x - Origin.x, y = m.y - Origin.y, z = m.z - Origin.z;
+    double b = x*x + y*y + z*z;
+    N   += 1;
+    Sx  += x;   Sy  += y;   Sz  += z;
+    Sxx += x*x; Sxy += x*y; Sxz += x*z;
+    Syy += y*y; Syz += y*z; Szz += z*z;
+    Sb  += b;   Sxb += x*b; Syb += y*b; Szb += z*b;
+    Sbb += b*b;
+}
+
+bool StreamingMagCalibration::Solve()
+{
+    if (N < 4)
+        return false;
+
+    // Each sample gives 2*c.p + k = |p|^2 with k = r^2 - |c|^2; these are the normal
+    // equations for u = (cx, cy, cz, k), augmented with the right hand side.
+    double a[4][5] =
+    {
+        { 4*Sxx, 4*Sxy, 4*Sxz, 2*Sx, 2*Sxb },
+        { 4*Sxy, 4*Syy, 4*Syz, 2*Sy, 2*Syb },
+        { 4*Sxz, 4*Syz, 4*Szz, 2*Sz, 2*Szb },
+        { 2*Sx,  2*Sy,  2*Sz,  N,    Sb    }
+    };
+    double m[4][4];
+    double rhs[4];
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+            m[i][j] = a[i][j];
+        rhs[i] = a[i][4];
+    }
+
+    // Gaussian elimination with partial pivoting. A pivot that is tiny relative to
+    // the matrix scale means the samples are (nearly) coplanar.
+    double scale = fabs(a[0][0]) + fabs(a[1][1]) + fabs(a[2][2]) + fabs(a[3][3]);
+    for (int col = 0; col < 4; col++)
+    {
+        int pivot = col;
+        for (int r = col + 1; r < 4; r++)
+            if (fabs(a[r][col]) > fabs(a[pivot][col]))
+                pivot = r;
+        if (fabs(a[pivot][col]) <= scale * 1e-12)
+            return false;
+        for (int k = 0; k < 5; k++)
+        {
+            double t    = a[col][k];
+            a[col][k]   = a[pivot][k];
+            a[pivot][k] = t;
+        }
+        for (int r = col + 1; r < 4; r++)
+        {
+            double f = a[r][col] / a[col][col];
+            for (int k = col; k < 5; k++)
+                a[r][k] -= f * a[col][k];
+        }
+    }
+    double u[4];
+    for (int i = 3; i >= 0; i--)
+    {
+        double sum = a[i][4];
+        for (int k = i + 1; k < 4; k++)
+            sum -= a[i][k] * u[k];
+        u[i] = sum / a[i][i];
+    }
+
+    double r2 = u[3] + u[0]*u[0] + u[1]*u[1] + u[2]*u[2];
+    if (r2 <= 0)
+        return false;
+
+    // Sum of squared algebraic residuals (|p|^2 - 2*c.p - k)^2, expanded in terms of
+    // the sums. Each is about 2r times the radial distance of the sample.
+    double sse = Sbb;
+    for (int i = 0; i < 4; i++)
+    {
+        sse -= 2 * u[i] * rhs[i];
+        for (int j = 0; j < 4; j++)
+            sse += u[i] * m[i][j] * u[j];
+    }
+    if (sse < 0)
+        sse = 0;
+
+    MagCenter = Vector3f((float)u[0] + Origin.x, (float)u[1] + Origin.y, (float)u[2] + Origin.z);
+    Radius    = (float)sqrt(r2);
+    Residual  = (float)(sqrt(sse / N) / (2 * Radius));
+    return true;
+}
+
+bool StreamingMagCalibration::Update(SensorFusion& sf)
+{
+    Vector3f m = sf.GetMagnetometer();
+
+    if (HasOrigin && ((m - LastSample).LengthSq() < MinMagDistanceSq))
+        return false;
+
+    AddSample(m);
+    LastSample = m;
+
+    if (++SinceSolve < SolvePeriod)
+        return false;
+    SinceSolve = 0;
+
+    if (!Solve() || (Residual > MaxResidualRatio * Radius))
+        return false;
+
+    Matrix4f calMat = Matrix4f();
+    calMat.M[0][3] = -MagCenter.x;
+    calMat.M[1][3] = -MagCenter.y;
+    calMat.M[2][3] = -MagCenter.z;
+    sf.SetMagCalibration(calMat);
+    return true;
+}
+
 }}
@@ -116,6 +116,74 @@ private:
 
 };
 
+
+//-------------------------------------------------------------------------------------
+// ***** StreamingMagCalibration
+
+// Least squares sphere fit over an unbounded stream of raw magnetometer samples.
+// Only the sums needed by the normal equations are kept, so memory and per-sample
+// cost are constant, and noisy samples are averaged out rather than trusted
+// individually. A sphere (hard iron offset) is fit rather than an ellipsoid since
+// SensorFusion only applies an offset.
+//
+// Samples can be added directly with AddSample and solved with Solve, or Update
+// can be called periodically to feed the fit from SensorFusion and refine its
+// calibration whenever a good enough solution is available.
+class StreamingMagCalibration
+{
+public:
+    StreamingMagCalibration();
+
+    void     Reset();
+
+    // Adds a raw magnetometer sample to the fit.
+    void     AddSample(const Vector3f& m);
+    // Effective number of samples in the fit (decays with the forget factor).
+    float    GetSampleWeight() const            { return (float)N; }
+
+    // Solves for the sphere center and radius; returns false if the samples
+    // don't determine a sphere (too few or too close to a plane).
+    bool     Solve();
+    Vector3f GetMagCenter() const               { return MagCenter; }
+    float    GetRadius() const                  { return Radius; }
+    // RMS distance of the samples from the fitted sphere, in Gauss (approximate).
+    float    GetResidual() const                { return Residual; }
+
+    // Continuous calibration: adds sf's current magnetometer reading if it is at least
+    // MinMagDistance from the last sample taken, re-solves every SolvePeriod samples
+    // and applies the result to sf if the residual is below MaxResidualRatio of the
+    // radius. Returns true when a new calibration was applied.
+    bool     Update(SensorFusion& sf);
+
+    void     SetMinMagDistance(float dist)      { MinMagDistanceSq = dist * dist; }
+    void     SetSolvePeriod(int samples)        { SolvePeriod = samples; }
+    void     SetMaxResidualRatio(float ratio)   { MaxResidualRatio = ratio; }
+    // Weight kept by existing samples when a new one is added; values below 1 let the
+    // fit follow a changing environment. 1 (the default) weighs all samples equally.
+    void     SetForgetFactor(float f)           { ForgetFactor = f; }
+
+private:
+    // Sums over samples relative to Origin, with b = x^2 + y^2 + z^2.
+    double   N;
+    double   Sx, Sy, Sz;
+    double   Sxx, Sxy, Sxz, Syy, Syz, Szz;
+    double   Sb, Sxb, Syb, Szb, Sbb;
+    // Samples are shifted by the first one to limit cancellation in the sums.
+    Vector3f Origin;
+    bool     HasOrigin;
+
+    Vector3f MagCenter;
+    float    Radius;
+    float    Residual;
+
+    Vector3f LastSample;
+    int      SinceSolve;
+    float    MinMagDistanceSq;
+    int      SolvePeriod;
+    float    MaxResidualRatio;
+    float    ForgetFactor;
+};
+
 }}
 
 #endif
@@ -0,0 +1,197 @@
+/************************************************************************************
+
+Filename    :   SensorFilterCheck.cpp
+Content     :   Console check of the Savitzky-Golay kernels against the fixed
+                coefficients they replaced
+Created     :   October 19, 2026
+Notes       :
+
+Copyright   :   Copyright 2013 Oculus VR, Inc. All Rights reserved.
+
+Use of this software is subject to the terms of the Oculus license
+agreement provided at the time of installation or download, or which
+otherwise accompanies this software in either electronic or hard copy form.
+
+*************************************************************************************/
+
+#include "OVR.h"
+#include "OVR_SensorFilter.h"
+#include <stdio.h>
+#include <math.h>
+
+using namespace OVR;
+
+//-------------------------------------------------------------------------------------
+// ***** SensorFilterCheck Description
+
+// SavitzkyGolayKernel computes its weights by solving the least squares system at
+// runtime, where SensorFilter used to apply hand-written coefficients. This program
+// checks that the kernels reproduce those coefficients, that the fixed-window filter
+// functions agree with SensorFilterBase::SavitzkyGolay on a sample stream, and that
+// kernels of higher order are exact on polynomials of that order. It prints one line
+// per check and exits with 1 if any of them fails.
+
+// The old tables were written out to five decimals, so weights may differ from them
+// by half a unit in the last place, plus float rounding of the solve.
+static const float RoundedCoefficientTolerance = 0.5e-5f + 1e-6f;
+// SavitzkyGolayDerivativeN used an exact formula.
+static const float ExactCoefficientTolerance   = 1e-6f;
+// Outputs on the sample stream are compared relative to the sum of the magnitudes
+// of the samples, which bounds the effect of the coefficient differences.
+static const float OutputTolerance             = RoundedCoefficientTolerance;
+// Exact fits of polynomials only suffer float rounding of the solve and the sums.
+static const float PolynomialTolerance         = 1e-4f;
+
+
+// Weights of the former fixed-window functions, applied to GetPrev(0), GetPrev(1), ...
+static const float OldSmooth8[8] =
+{ 0.41667f, 0.33333f, 0.25f, 0.16667f, 0.08333f, 0.0f, -0.08333f, -0.16667f };
+
+static const float OldDerivative4[4] =
+{ 0.3f, 0.1f, -0.1f, -0.3f };
+
+static const float OldDerivative5[5] =
+{ 0.2f, 0.1f, 0.0f, -0.1f, -0.2f };
+
+static const float OldDerivative12[12] =
+{ 0.03846f, 0.03147f, 0.02448f, 0.01748f, 0.01049f, 0.0035f,
+  -0.0035f, -0.01049f, -0.01748f, -0.02448f, -0.03147f, -0.03846f };
+
+// Weight of GetPrev(i) in the former SavitzkyGolayDerivativeN(n), for odd n.
+static float oldDerivativeNCoefficient(int n, int i)
+{
+    int   m    = (n - 1) / 2;
+    float coef = 3.0f / (m * (m + 1.0f) * (2.0f * m + 1.0f));
+    return (m - i) * coef;
+}
+
+
+static int Failures = 0;
+
+static void report(const char* name, float error, float tolerance)
+{
+    bool pass = (error <= tolerance);
+    if (!pass)
+        Failures++;
+    printf("%-34s max error %.3g (tolerance %.3g)  %s\n",
+           name, error, tolerance, pass ? "ok" : "FAILED");
+}
+
+static float checkCoefficients(const SavitzkyGolayKernel& kernel, const float* old)
+{
+    float maxError = 0;
+    for (int i = 0; i < kernel.GetWindowSize(); i++)
+        maxError = Alg::Max(maxError, fabsf(kernel.GetCoefficient(i) - old[i]));
+    return maxError;
+}
+
+// Relative difference of a and b, scaled by the sum of absolute terms in 'scale'.
+static float relativeError(const Vector3f& a, const Vector3f& b, float scale)
+{
+    Vector3f d = a - b;
+    float    e = Alg::Max(fabsf(d.x), Alg::Max(fabsf(d.y), fabsf(d.z)));
+    return e / Alg::Max(scale, 1e-6f);
+}
+
+// Sum of |GetPrev(i)| over the window, per largest axis; used to scale errors.
+static float termScale(const SensorFilter& f, int n)
+{
+    float s = 0;
+    for (int i = 0; i < n; i++)
+    {
+        Vector3f v = f.GetPrev(i);
+        s += Alg::Max(fabsf(v.x), Alg::Max(fabsf(v.y), fabsf(v.z)));
+    }
+    return s;
+}
+
+
+int main()
+{
+    System::Init(Log::ConfigureDefaultLog(LogMask_All));
+
+    {
+        SavitzkyGolayKernel smooth8(8, 1, 0);
+        SavitzkyGolayKernel derivative4(4, 1, 1);
+        SavitzkyGolayKernel derivative5(5, 1, 1);
+        SavitzkyGolayKernel derivative12(12, 1, 1);
+        SavitzkyGolayKernel derivative9(9, 1, 1);
+
+        // Kernel weights against the old tables.
+        report("Smooth8 coefficients",      checkCoefficients(smooth8, OldSmooth8),
+               RoundedCoefficientTolerance);
+        report("Derivative4 coefficients",  checkCoefficients(derivative4, OldDerivative4),
+               RoundedCoefficientTolerance);
+        report("Derivative5 coefficients",  checkCoefficients(derivative5, OldDerivative5),
+               RoundedCoefficientTolerance);
+        report("Derivative12 coefficients", checkCoefficients(derivative12, OldDerivative12),
+               RoundedCoefficientTolerance);
+
+        float maxError = 0;
+        for (int n = 3; n <= 31; n += 2)
+        {
+            SavitzkyGolayKernel derivativeN(n, 1, 1);
+            for (int i = 0; i < n; i++)
+            {
+                float e = fabsf(derivativeN.GetCoefficient(i) - oldDerivativeNCoefficient(n, i));
+                maxError = Alg::Max(maxError, e);
+            }
+        }
+        report("DerivativeN coefficients, n 3-31", maxError, ExactCoefficientTolerance);
+
+        // Filter outputs on a noisy stream, across ring wraparound.
+        SensorFilter f(32);
+        float        errors[5] = { 0, 0, 0, 0, 0 };
+        unsigned     seed      = 1;
+        for (int i = 0; i < 2000; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            float noise = (float)(seed >> 8) / (float)(1 << 24) - 0.5f;
+            float t     = i * 0.001f;
+            f.AddElement(Vector3f(3.0f * sinf(7.0f * t) + 0.01f * noise,
+                                  0.5f * i, cosf(21.0f * t) - noise));
+            if (i < 32)
+                continue;
+
+            errors[0] = Alg::Max(errors[0], relativeError(f.SavitzkyGolay(smooth8),
+                                 f.SavitzkyGolaySmooth8(), termScale(f, 8)));
+            errors[1] = Alg::Max(errors[1], relativeError(f.SavitzkyGolay(derivative4),
+                                 f.SavitzkyGolayDerivative4(), termScale(f, 4)));
+            errors[2] = Alg::Max(errors[2], relativeError(f.SavitzkyGolay(derivative5),
+                                 f.SavitzkyGolayDerivative5(), termScale(f, 5)));
+            errors[3] = Alg::Max(errors[3], relativeError(f.SavitzkyGolay(derivative12),
+                                 f.SavitzkyGolayDerivative12(), termScale(f, 12)));
+            errors[4] = Alg::Max(errors[4], relativeError(f.SavitzkyGolay(derivative9),
+                                 f.SavitzkyGolayDerivativeN(9), termScale(f, 9)));
+        }
+        report("Smooth8 output",       errors[0], OutputTolerance);
+        report("Derivative4 output",   errors[1], OutputTolerance);
+        report("Derivative5 output",   errors[2], OutputTolerance);
+        report("Derivative12 output",  errors[3], OutputTolerance);
+        report("DerivativeN(9) output", errors[4], OutputTolerance);
+
+        // Higher orders have no old counterpart; a fit of order p must reproduce a
+        // polynomial of order p and its derivatives at the newest sample.
+        SensorFilter q(16);
+        for (int i = 0; i < 16; i++)
+        {
+            float t = (float)i;
+            q.AddElement(Vector3f(t * t, 2.0f * t + 1.0f, 0.25f * t * t * t));
+        }
+        // Newest sample at t = 15.
+        float quadError =
+            Alg::Max(fabsf(q.SavitzkyGolay(SavitzkyGolayKernel(7, 2, 0)).x - 225.0f) / 225.0f,
+            Alg::Max(fabsf(q.SavitzkyGolay(SavitzkyGolayKernel(7, 2, 1)).x - 30.0f) / 30.0f,
+                     fabsf(q.SavitzkyGolay(SavitzkyGolayKernel(7, 2, 2)).x - 2.0f) / 2.0f));
+        float cubicError =
+            Alg::Max(fabsf(q.SavitzkyGolay(SavitzkyGolayKernel(9, 3, 0)).z - 843.75f) / 843.75f,
+                     fabsf(q.SavitzkyGolay(SavitzkyGolayKernel(9, 3, 1)).z - 168.75f) / 168.75f);
+        report("Order 2 on quadratic", quadError, PolynomialTolerance);
+        report("Order 3 on cubic",     cubicError, PolynomialTolerance);
+    }
+
+    System::Destroy();
+
+    printf("%s\n", Failures ? "SensorFilterCheck FAILED" : "SensorFilterCheck passed");
+    return Failures ? 1 : 0;
+}